@@ -6,6 +6,8 @@
 #include "ntv2signalrouter.h"
 #include "ntv2utils.h"
 #include <ntv2devicescanner.h>
+#include <algorithm>
+#include <cstring>
 #include <ranges>
 #include <system/process.h>
 
@@ -52,9 +54,9 @@ uint64_t AJADevice::FindDeviceSerial(const char* ident)
 
 bool AJADevice::DeviceAvailable(const char* ident, bool input)
 {
-    if(FindDeviceSerial(ident))
+    if(auto serial = FindDeviceSerial(ident))
     {
-        auto dev = GetDevice(ident);
+        auto dev = GetDeviceBySerialNumber(serial);
         return !dev || (input ? !dev->HasInput : !dev->HasOutput);
     }
     return false;
@@ -63,6 +65,7 @@ bool AJADevice::DeviceAvailable(const char* ident, bool input)
 bool AJADevice::GetAvailableDevice(bool input, AJADevice** pOut)
 {
     if(AvailableDevices.empty()) return false;
+    std::unique_lock lock(DevicesMutex);
     if(Devices.empty()) return true;
     for(auto& [_, dev] : Devices)
         if(input ? !dev->HasInput : !dev->HasOutput)
@@ -75,19 +78,36 @@ bool AJADevice::GetAvailableDevice(bool input, AJADevice** pOut)
 
 void AJADevice::Init()
 {
-    if(AvailableDevices.empty() || !Devices.empty()) 
-    {
-        return;
-    }
-    
-    CNTV2DeviceScanner scanner;
-    CNTV2Card dev;
-    for (ULWord i = 0; scanner.GetDeviceAtIndex(i, dev); i++)
-        Devices[dev.GetSerialNumber()] = (std::make_shared<AJADevice>(dev.GetSerialNumber())); // TODO: Error check on AJADevice ctor.
+    std::unique_lock lock(DevicesMutex);
+    if(AvailableDevices.empty())
+        AvailableDevices = EnumerateDevices();
+}
+
+std::map<std::string, uint64_t> AJADevice::RefreshDevices()
+{
+    auto available = EnumerateDevices();
+    std::unique_lock lock(DevicesMutex);
+    AvailableDevices = available;
+    // Boards that failed to open are tried again by the next request
+    std::erase_if(OpeningDevices, [](auto const& entry) {
+        auto& future = entry.second;
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready && !future.get();
+    });
+    return available;
 }
 
 void AJADevice::Deinit()
 {
+    std::vector<std::shared_future<std::shared_ptr<AJADevice>>> opening;
+    {
+        std::unique_lock lock(DevicesMutex);
+        for (auto& [_, future] : OpeningDevices)
+            opening.push_back(future);
+    }
+    for (auto& future : opening)
+        future.wait();
+
+    std::unique_lock lock(DevicesMutex);
     for(auto& [_, dev] : Devices)
     {
         if(dev->HasInput || dev->HasOutput)
@@ -96,23 +116,63 @@ void AJADevice::Deinit()
         }
     }
     Devices.clear();
+    OpeningDevices.clear();
+    AvailableDevices.clear();
+}
+
+// Guarded by DevicesMutex. Invalid if the board is not available. A board that failed to open keeps its future, so it
+// is not opened again until RefreshDevices.
+static std::shared_future<std::shared_ptr<AJADevice>> StartOpeningDevice(uint64_t serial)
+{
+    if (auto it = AJADevice::OpeningDevices.find(serial); it != AJADevice::OpeningDevices.end())
+        return it->second;
+    if (AJADevice::AvailableDevices.empty())
+        AJADevice::AvailableDevices = AJADevice::EnumerateDevices();
+    if (!std::ranges::any_of(AJADevice::AvailableDevices, [serial](auto const& entry) { return entry.second == serial; }))
+        return {};
+    auto future = std::async(std::launch::async, [serial]() -> std::shared_ptr<AJADevice> {
+        auto device = std::make_shared<AJADevice>(serial);
+        std::unique_lock lock(AJADevice::DevicesMutex);
+        if (!device->IsInitialized())
+            return nullptr;
+        AJADevice::Devices[serial] = device;
+        return device;
+    }).share();
+    AJADevice::OpeningDevices[serial] = future;
+    return future;
+}
+
+void AJADevice::OpenAsync(std::string const& name)
+{
+    Init();
+    std::unique_lock lock(DevicesMutex);
+    if (auto serial = FindDeviceSerial(name.c_str()); serial && !Devices.contains(serial))
+        StartOpeningDevice(serial);
+}
+
+std::vector<std::shared_ptr<AJADevice>> AJADevice::GetOpenDevices()
+{
+    std::unique_lock lock(DevicesMutex);
+    std::vector<std::shared_ptr<AJADevice>> devices;
+    for (auto& [_, dev] : Devices)
+        devices.push_back(dev);
+    std::sort(devices.begin(), devices.end(), [](auto const& a, auto const& b) { return a->GetIndexNumber() < b->GetIndexNumber(); });
+    return devices;
 }
 
 std::shared_ptr<AJADevice> AJADevice::GetDevice(std::string const& name)
 {
-    for(auto& [_, dev]: Devices)
+    uint64_t serial = 0;
     {
-        if(name == dev->GetDisplayName())
-        {
-            return dev;
-        }
+        std::unique_lock lock(DevicesMutex);
+        serial = FindDeviceSerial(name.c_str());
     }
-    return 0;
+    return serial ? OpenDevice(serial) : nullptr;
 }
 
 std::shared_ptr<AJADevice> AJADevice::GetDevice(uint32_t index)
 {
-	for(auto& [_, dev]: Devices)
+	for(auto& dev: GetOpenDevices())
 	{
 		if(index == dev->GetIndexNumber())
 		{
@@ -124,10 +184,27 @@ std::shared_ptr<AJADevice> AJADevice::GetDevice(uint32_t index)
 
 std::shared_ptr<AJADevice> AJADevice::GetDeviceBySerialNumber(uint64_t serial)
 {
-	auto it = Devices.find(serial);
-	if (it != Devices.end())
-		return it->second;
-	return nullptr;
+	std::shared_future<std::shared_ptr<AJADevice>> opening;
+	{
+		std::unique_lock lock(DevicesMutex);
+		if (auto it = Devices.find(serial); it != Devices.end())
+			return it->second;
+		if (auto it = OpeningDevices.find(serial); it != OpeningDevices.end())
+			opening = it->second;
+	}
+	return opening.valid() ? opening.get() : nullptr;
+}
+
+std::shared_ptr<AJADevice> AJADevice::OpenDevice(uint64_t serial)
+{
+	std::shared_future<std::shared_ptr<AJADevice>> opening;
+	{
+		std::unique_lock lock(DevicesMutex);
+		if (auto it = Devices.find(serial); it != Devices.end())
+			return it->second;
+		opening = StartOpeningDevice(serial);
+	}
+	return opening.valid() ? opening.get() : nullptr;
 }
 
 CNTV2VPID AJADevice::GetVPID(NTV2Channel channel, CNTV2VPID* B)
@@ -185,35 +262,78 @@ AJADevice::Mode AJADevice::GetMode(NTV2Channel channel)
     return IsTSI(channel) ? TSI : CNTV2VPID::VPIDStandardIsQuadLink(GetVPID(channel).GetStandard()) ? SQD : SL;
 }
 
+static const ULWord ChannelControlRegisters[NTV2_MAX_NUM_CHANNELS] = {
+    kRegCh1Control, kRegCh2Control, kRegCh3Control, kRegCh4Control,
+    kRegCh5Control, kRegCh6Control, kRegCh7Control, kRegCh8Control,
+};
+
+static const ULWord SDITransmitMasks[NTV2_MAX_NUM_CHANNELS] = {
+    kRegMaskSDI1Transmit, kRegMaskSDI2Transmit, kRegMaskSDI3Transmit, kRegMaskSDI4Transmit,
+    kRegMaskSDI5Transmit, kRegMaskSDI6Transmit, kRegMaskSDI7Transmit, kRegMaskSDI8Transmit,
+};
+
 void AJADevice::ClearState()
 {
     CNTV2Card::ClearRouting();
-    for (int i = 0; i < 8; ++i)
+    // Frame stores and SDI transmitters are read in one batch, only those in use are reset, with one batch of writes
+    const ULWord frameStores = std::min<ULWord>(NTV2DeviceGetNumFrameStores(ID), NTV2_MAX_NUM_CHANNELS);
+    const bool biDirectional = NTV2DeviceHasBiDirectionalSDI(ID);
+    NTV2RegisterReads reads;
+    for (ULWord i = 0; i < frameStores; ++i)
+        reads.push_back(NTV2RegInfo(ChannelControlRegisters[i]));
+    reads.push_back(NTV2RegInfo(kRegSDITransmitControl));
+    const bool known = ReadRegisters(reads);
+    const ULWord transmitting = known ? reads.back().registerValue : 0xFFFFFFFF;
+    NTV2RegisterWrites writes;
+    for (ULWord i = 0; i < 8; ++i)
     {
         auto channel = NTV2Channel(i);
         UnsubscribeInputVerticalEvent(channel);
         UnsubscribeOutputVerticalEvent(channel);
         DisableInputInterrupt(channel);
         DisableOutputInterrupt(channel);
-        DisableChannel(channel);
-        SetSDITransmitEnable(channel, false);
-        SetMode(channel, NTV2_MODE_INVALID);
+        if (i >= frameStores)
+            continue;
+        if (!known || !(reads[i].registerValue & kRegMaskChannelDisable))
+        {
+            writes.push_back(NTV2RegInfo(ChannelControlRegisters[i], kRegMaskChannelDisable, kRegMaskChannelDisable));
+            SetMode(channel, NTV2_MODE_INVALID);
+        }
+        if (biDirectional && (transmitting & SDITransmitMasks[i]))
+            writes.push_back(NTV2RegInfo(kRegSDITransmitControl, 0, SDITransmitMasks[i]));
     }
+    if (!writes.empty())
+        WriteRegisters(writes);
     SetReference(NTV2_REFERENCE_EXTERNAL);
 }
 
 u32 AJADevice::GetFBSize(NTV2Channel channel)
 {
     NTV2Framesize fsz = NTV2_FRAMESIZE_INVALID;
-    bool quad = false;
+    bool quad = false, quadQuad = false;
     GetFrameBufferSize(channel, fsz);
     GetQuadFrameEnable(quad, channel);
-    return NTV2FramesizeToByteCount(fsz) * (quad ? 4 : 1);
+    if (Can12G())
+        GetQuadQuadFrameEnable(quadQuad, channel);
+    return NTV2FramesizeToByteCount(fsz) * (quadQuad ? 16 : quad ? 4 : 1);
 }
 
 AJADevice::~AJADevice()
 {
+    if (!Initialized)
+    {
+        Close();
+        return;
+    }
+    StopInputSignalMonitor();
+    for (int i = 0; i < NTV2_MAX_NUM_CHANNELS; ++i)
+    {
+        CloseAudio(NTV2Channel(i));
+        CloseOutputQueue(NTV2Channel(i));
+    }
     ClearState();
+    for (int i = 0; i < NTV2_MAX_NUM_CHANNELS; ++i)
+        ClearCapturedFrames(NTV2Channel(i));
 	int32_t processId = static_cast<int32_t>(AJAProcess::GetPid());
     ReleaseStreamForApplication(NTV2_FOURCC('M', 'Z', 'M', 'Z'), processId);
     Close();
@@ -222,6 +342,7 @@ AJADevice::~AJADevice()
 AJADevice::AJADevice(uint64_t serial)
 {
     AJAStatus	status	(AJA_STATUS_SUCCESS);
+    const auto openStart = std::chrono::steady_clock::now();
 
     //	Open the device...
     if (!CNTV2DeviceScanner::GetDeviceWithSerial (serial, *this))
@@ -237,6 +358,8 @@ AJADevice::AJADevice(uint64_t serial)
     }
 
     ID =  GetDeviceID();
+    // The driver numbers boards in PCI order, so the n-th AJA function on the bus is board n
+    NumaNode = nos::aja::FindPciNumaNode(0xf1d0, GetIndexNumber());
 
     if (!::NTV2DeviceCanDoCapture(ID))
     {
@@ -250,7 +373,12 @@ AJADevice::AJADevice(uint64_t serial)
     AJA_ASSERT(SetMultiFormatMode(true));
     AJA_ASSERT(SetReference(NTV2_REFERENCE_EXTERNAL));
 
+    const auto resetStart = std::chrono::steady_clock::now();
     ClearState();
+    const auto end = std::chrono::steady_clock::now();
+    nosEngine.LogI("AJA: Opened %s in %.1f ms, %.1f ms of it resetting", GetDisplayName().c_str(),
+                   std::chrono::duration<double, std::milli>(end - openStart).count(), std::chrono::duration<double, std::milli>(end - resetStart).count());
+    Initialized = true;
 }
 
 bool AJADevice::ChannelIsValid(NTV2Channel channel, bool isInput, NTV2VideoFormat fmt, Mode mode)
@@ -270,10 +398,18 @@ bool AJADevice::CanChannelDoFormat(NTV2Channel channel, bool isInput, NTV2VideoF
 {
 	if (isInput)
 		return true;
-	if ((NTV2_FRAMERATE_INVALID != FPSFamily) && (GetFrameRateFamily(GetNTV2FrameRateFromVideoFormat(fmt)) != GetFrameRateFamily(FPSFamily)))
+	if ((NTV2_FRAMERATE_INVALID != FPSFamily) && (GetFrameRateFamily(GetNTV2FrameRateFromVideoFormat(fmt)) != GetFrameRateFamily(FPSFamily)) && !CanDoCrossRateOutputs())
 		return false;
 
-	return NTV2DeviceCanDoVideoFormat(ID, fmt) && (SL == mode || NTV2_IS_QUAD_FRAME_FORMAT(fmt));
+	if (!NTV2DeviceCanDoVideoFormat(ID, fmt))
+		return false;
+	// 8K goes out over four 12G links, squares only
+	if (NTV2_IS_QUAD_QUAD_FORMAT(fmt))
+		return SL != mode && TSI != mode && Can12G();
+	// UHD over four 3G links, or one 12G link
+	if (NTV2_IS_QUAD_FRAME_FORMAT(fmt))
+		return SL != mode || Can12G();
+	return SL == mode;
 }
 
 bool AJADevice::ChannelCanInput(NTV2Channel channel)
@@ -411,7 +547,7 @@ bool AJADevice::CanMakeQuadOutputFromChannel(NTV2Channel channel)
     return true;
 }
 
-uint64_t AJADevice::GetLastInputVerticalInterruptTimestamp(NTV2Channel channel)
+static VirtualRegisterNum GetInputTimestampRegister(NTV2Channel channel)
 {
     VirtualRegisterNum loRegisterNum = kVRegTimeStampLastInput1VerticalLo;
     switch (channel)
@@ -431,6 +567,12 @@ uint64_t AJADevice::GetLastInputVerticalInterruptTimestamp(NTV2Channel channel)
     default:
         break;
     }
+    return loRegisterNum;
+}
+
+uint64_t AJADevice::GetLastInputVerticalInterruptTimestamp(NTV2Channel channel)
+{
+    VirtualRegisterNum loRegisterNum = GetInputTimestampRegister(channel);
     ULWord nanosecondsLo = 0;
 	ULWord nanosecondsHi = 0;
 	ReadRegister(loRegisterNum, nanosecondsLo);
@@ -438,6 +580,139 @@ uint64_t AJADevice::GetLastInputVerticalInterruptTimestamp(NTV2Channel channel)
     return ((uint64_t(nanosecondsHi) << 32) | nanosecondsLo)*100;
 }
 
+uint64_t AJADevice::GetLastOutputVerticalInterruptTimestamp(NTV2Channel channel)
+{
+    VirtualRegisterNum loRegisterNum = kVRegTimeStampLastOutputVerticalLo;
+    if (channel > NTV2_CHANNEL1 && channel <= NTV2_CHANNEL8)
+        loRegisterNum = VirtualRegisterNum(kVRegTimeStampLastOutput2VerticalLo + (channel - NTV2_CHANNEL2) * 2);
+    ULWord nanosecondsLo = 0;
+    ULWord nanosecondsHi = 0;
+    ReadRegister(loRegisterNum, nanosecondsLo);
+    ReadRegister(VirtualRegisterNum(loRegisterNum + 1), nanosecondsHi);
+    return ((uint64_t(nanosecondsHi) << 32) | nanosecondsLo) * 100;
+}
+
+// DBB, bits 0-31 and bits 32-63 of each SDI's RP188 registers
+static const ULWord RP188Registers[NTV2_MAX_NUM_CHANNELS][3] = {
+    {kRegRP188InOut1DBB, kRegRP188InOut1Bits0_31, kRegRP188InOut1Bits32_63},
+    {kRegRP188InOut2DBB, kRegRP188InOut2Bits0_31, kRegRP188InOut2Bits32_63},
+    {kRegRP188InOut3DBB, kRegRP188InOut3Bits0_31, kRegRP188InOut3Bits32_63},
+    {kRegRP188InOut4DBB, kRegRP188InOut4Bits0_31, kRegRP188InOut4Bits32_63},
+    {kRegRP188InOut5DBB, kRegRP188InOut5Bits0_31, kRegRP188InOut5Bits32_63},
+    {kRegRP188InOut6DBB, kRegRP188InOut6Bits0_31, kRegRP188InOut6Bits32_63},
+    {kRegRP188InOut7DBB, kRegRP188InOut7Bits0_31, kRegRP188InOut7Bits32_63},
+    {kRegRP188InOut8DBB, kRegRP188InOut8Bits0_31, kRegRP188InOut8Bits32_63},
+};
+
+static const ULWord OutputFrameRegisters[NTV2_MAX_NUM_CHANNELS] = {
+    kRegCh1OutputFrame, kRegCh2OutputFrame, kRegCh3OutputFrame, kRegCh4OutputFrame,
+    kRegCh5OutputFrame, kRegCh6OutputFrame, kRegCh7OutputFrame, kRegCh8OutputFrame,
+};
+
+bool AJADevice::ReadInputFrameInfo(NTV2Channel channel, InputFrameInfo& info)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel))
+        return false;
+
+    // One call for everything latched at the VBL
+    VirtualRegisterNum timestampRegister = GetInputTimestampRegister(channel);
+    NTV2RegisterReads reads = {
+        NTV2RegInfo(timestampRegister),
+        NTV2RegInfo(timestampRegister + 1),
+    };
+    bool hasTimecode = NTV2DeviceCanDoRP188(ID);
+    if (hasTimecode)
+        for (auto reg : RP188Registers[channel])
+            reads.push_back(NTV2RegInfo(reg));
+    if (!ReadRegisters(reads))
+        return false;
+
+    info.TimestampNs = ((uint64_t(reads[1].registerValue) << 32) | reads[0].registerValue) * 100;
+    info.Timecode = NTV2_RP188();
+    if (hasTimecode)
+        info.Timecode = NTV2_RP188(reads[2].registerValue, reads[3].registerValue, reads[4].registerValue);
+    return true;
+}
+
+bool AJADevice::WriteOutputFrameState(NTV2Channel channel, bool isQuad, std::optional<ULWord> frame, NTV2_RP188 const* timecode, ULWord linkFrameStep)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel))
+        return false;
+    const u32 last = std::min<u32>(channel + (isQuad ? 4 : 1), NTV2_MAX_NUM_CHANNELS);
+    NTV2RegisterWrites writes;
+    // Timecode goes first so that it is in place when the new frame is latched
+    if (timecode && NTV2DeviceCanDoRP188(ID))
+    {
+        for (u32 link = channel; link < last; ++link)
+        {
+            writes.push_back(NTV2RegInfo(RP188Registers[link][0], timecode->fDBB, kRegMaskRP188DBB));
+            writes.push_back(NTV2RegInfo(RP188Registers[link][1], timecode->fLo));
+            writes.push_back(NTV2RegInfo(RP188Registers[link][2], timecode->fHi));
+        }
+    }
+    if (frame)
+        for (u32 link = channel; link < last; ++link)
+            writes.push_back(NTV2RegInfo(OutputFrameRegisters[link], *frame + (link - channel) * linkFrameStep));
+    return writes.empty() || WriteRegisters(writes);
+}
+
+bool AJADevice::WriteOutputAnc(NTV2Channel channel, ULWord frame, AJAAncillaryList& packets, NTV2VideoFormat videoFmt)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel) || !NTV2DeviceCanDoCustomAnc(ID))
+        return false;
+    if (!AncInsertEnabled[channel])
+    {
+        if (!AncInsertInit(UWord(channel), channel, GetNTV2StandardFromVideoFormat(videoFmt)) || !AncInsertSetEnable(UWord(channel), true))
+            return false;
+        AncInsertEnabled[channel] = true;
+    }
+    NTV2Buffer f1(NTV2_ANCSIZE_MAX), f2(NTV2_ANCSIZE_MAX);
+    const bool progressive = IsProgressivePicture(videoFmt);
+    const ULWord f2StartLine = progressive ? 0 : NTV2SmpteLineNumber(GetNTV2StandardFromVideoFormat(videoFmt)).GetLastLine();
+    if (AJA_FAILURE(packets.GetTransmitData(f1, f2, progressive, f2StartLine)))
+        return false;
+    return DMAWriteAnc(frame, f1, f2, channel);
+}
+
+static TimecodeFormat GetTimecodeFormat(NTV2VideoFormat videoFmt)
+{
+    switch (GetNTV2FrameRateFromVideoFormat(videoFmt))
+    {
+    case NTV2_FRAMERATE_2398:
+    case NTV2_FRAMERATE_2400: return kTCFormat24fps;
+    case NTV2_FRAMERATE_2500: return kTCFormat25fps;
+    case NTV2_FRAMERATE_2997: return kTCFormat30fpsDF;
+    case NTV2_FRAMERATE_3000: return kTCFormat30fps;
+    case NTV2_FRAMERATE_4795:
+    case NTV2_FRAMERATE_4800: return kTCFormat48fps;
+    case NTV2_FRAMERATE_5000: return kTCFormat50fps;
+    case NTV2_FRAMERATE_5994: return kTCFormat60fpsDF;
+    case NTV2_FRAMERATE_6000: return kTCFormat60fps;
+    default: return kTCFormatUnknown;
+    }
+}
+
+bool AJADevice::EncodeTimecode(std::string const& text, NTV2VideoFormat videoFmt, NTV2_RP188& timecode)
+{
+    CRP188 rp188(text, GetTimecodeFormat(videoFmt));
+    timecode = NTV2_RP188();
+    rp188.GetRP188Reg(timecode);
+    return timecode.IsValid();
+}
+
+bool AJADevice::DecodeTimecode(NTV2_RP188 const& timecode, NTV2VideoFormat videoFmt, std::string& text, uint32_t& frameCount)
+{
+    if (!timecode.IsValid() || (timecode.fLo == 0xFFFFFFFF && timecode.fHi == 0xFFFFFFFF))
+        return false;
+    CRP188 rp188(timecode, GetTimecodeFormat(videoFmt));
+    if (!rp188.GetRP188Str(text))
+        return false;
+    ULWord frames = 0;
+    rp188.GetFrameCount(frames);
+    frameCount = frames;
+    return true;
+}
+
 
 static bool GetTSIMUXPins(NTV2Channel channel, NTV2InputCrosspointID& in, NTV2OutputCrosspointID& out)
 {
@@ -488,7 +763,7 @@ static NTV2OutputCrosspointID GetOutputTSIFB(NTV2Channel channel)
     }
 }
 
-bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt)
+bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt, bool separateSquares)
 {
     std::unique_lock lock(ChannelsMutex);
 
@@ -521,12 +796,25 @@ bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoF
     
     if (((mode == TSI) != isTsi) || ((mode == SQD) != !isTsi))
         nosEngine.LogE("Warning: Detected signal is %s but requested config is %s", isTsi ? "TSI" : "Squares", (mode == TSI) ? "TSI" : "Squares");;
+
+    // 8K: each link is a 12G UHD quadrant and the four frame stores make one 8K frame store
+    const bool quadQuad = NTV2_IS_QUAD_QUAD_FORMAT(videoFmt);
+    if (quadQuad && (mode != SQD || !Can12G()))
+    {
+        nosEngine.LogE("8K inputs are only supported in squares mode on 12G devices");
+        return false;
+    }
+    if (separateSquares && (mode != SQD || quadQuad))
+    {
+        nosEngine.LogE("Separate squares need a squares mode UHD input");
+        return false;
+    }
     
-    bool re = SetQuadFrameEnable(true, channel);
+    bool re = separateSquares ? SetQuadFrameEnable(false, channel) : quadQuad ? SetQuadQuadFrameEnable(true, channel) : SetQuadFrameEnable(true, channel);
 
     for(int i = 0; i < ARRAYSIZE(channels); ++i)
     {
-        NTV2VideoFormat fmt = GetInputVideoFormat(channels[i]);
+        NTV2VideoFormat fmt = quadQuad ? videoFmt : GetInputVideoFormat(channels[i]);
         if (!NTV2_IS_QUAD_FRAME_FORMAT(fmt))
         {
             NTV2FrameRate fps;
@@ -541,6 +829,8 @@ bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoF
         re &= SetSDITransmitEnable(channels[i], false);
         re &= SetEnableVANCData(false, false, channels[i]);
         re &= SetMode(channels[i], NTV2_MODE_INPUT);
+        if (NTV2DeviceCanDoRP188(ID))
+            SetRP188Mode(channels[i], NTV2_RP188_INPUT);
         re &= SetVideoFormat(fmt, false, false, channels[i]);
         re &= SetFrameBufferFormat(channels[i], fbFmt);
         
@@ -557,7 +847,10 @@ bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoF
             break;
         case SQD:
             re &= SetTsiFrameEnable(false, channels[i]);
-            re &= Set4kSquaresEnable(true, channels[i]);
+            if (quadQuad)
+                re &= SetQuadQuadSquaresEnable(true, channels[i]);
+            else if (!separateSquares) // Otherwise each link's frame store holds its HD quadrant
+                re &= Set4kSquaresEnable(true, channels[i]);
             re &= Connect(GetFrameBufferInputXptFromChannel(channels[i]), GetInputSourceOutputXpt(src));
             break;
         default:
@@ -571,7 +864,7 @@ bool AJADevice::RouteQuadInputSignal(NTV2Channel channel, NTV2VideoFormat videoF
     return re;
 }
 
-bool AJADevice::RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat fmt, Mode mode, NTV2FrameBufferFormat fbFmt)
+bool AJADevice::RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat fmt, Mode mode, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground, bool separateSquares)
 {
     std::unique_lock lock(ChannelsMutex);
 
@@ -595,12 +888,55 @@ bool AJADevice::RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat fmt,
         }
     }
 
+    // 8K: each link carries a 12G UHD quadrant of the four frame stores made into one 8K frame store
+    const bool quadQuad = NTV2_IS_QUAD_QUAD_FORMAT(fmt);
+
     if (mode == AUTO)
     {
-        mode = TSI;
+        mode = quadQuad ? SQD : TSI;
+    }
+
+    const bool keyed = NTV2_IS_VALID_CHANNEL(keyerBackground);
+    if (quadQuad && (mode != SQD || keyed || !Can12G()))
+    {
+        nosEngine.LogE("8K outputs are only supported unkeyed in squares mode on 12G devices");
+        return false;
+    }
+    // Separate squares: each link's frame store holds its quadrant in the HD format of the link
+    NTV2VideoFormat linkFmt = fmt;
+    if (separateSquares)
+    {
+        linkFmt = GetFirstMatchingVideoFormat(GetNTV2FrameRateFromVideoFormat(fmt), UWord(GetDisplayHeight(fmt) / 2), UWord(GetDisplayWidth(fmt) / 2), false, false, false);
+        if (mode != SQD || quadQuad || keyed || linkFmt == NTV2_FORMAT_UNKNOWN)
+        {
+            nosEngine.LogE("Separate squares need an unkeyed squares mode UHD output");
+            return false;
+        }
+    }
+    const NTV2Channel keyChannel = GetKeyChannel(channel, true);
+    if (keyed)
+    {
+        // Each link goes through its own mixer, keys are in the frame stores of the other four channels
+        if (mode != SQD)
+        {
+            nosEngine.LogE("Keying quad link outputs is only supported in squares mode");
+            return false;
+        }
+        if (NTV2DeviceGetNumMixers(ID) < 4 || keyChannel + 3 >= NTV2DeviceGetNumFrameStores(ID) || (keyerBackground & 3))
+            return false;
+        for (u32 i = 0; i < 4; ++i)
+        {
+            if (Channels.contains(NTV2Channel(keyChannel + i)))
+                return false;
+            auto bg = Channels.find(NTV2Channel(keyerBackground + i));
+            if (bg != Channels.end() && !bg->second)
+                return false;
+        }
     }
     
-    bool re = SetQuadFrameEnable(true, channel);
+    bool re = separateSquares ? SetQuadFrameEnable(false, channel) : quadQuad ? SetQuadQuadFrameEnable(true, channel) : SetQuadFrameEnable(true, channel);
+    if (keyed)
+        re &= SetQuadFrameEnable(true, keyChannel);
 
     for(int i = 0; i < ARRAYSIZE(channels); ++i)
     {
@@ -611,7 +947,9 @@ bool AJADevice::RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat fmt,
         re &= (SetSDITransmitEnable(channels[i], true));
         re &= (SetEnableVANCData(false, false, channels[i]));
         re &= (SetMode(channels[i], NTV2_MODE_OUTPUT));
-        re &= (SetVideoFormat(fmt, false, false, channels[i]));
+        if (NTV2DeviceCanDoRP188(ID))
+            SetRP188Mode(channels[i], NTV2_RP188_OUTPUT);
+        re &= (SetVideoFormat(linkFmt, false, false, channels[i]));
         re &= (SetFrameBufferFormat(channels[i], fbFmt));
         auto dst = NTV2ChannelToOutputDestination(channels[i]);
         
@@ -626,8 +964,20 @@ bool AJADevice::RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat fmt,
             re &= (Connect(in, GetOutputTSIFB(channels[i])));
             break;
         case SQD:
-            re &= Set4kSquaresEnable(true, channels[i]);
-            re &= Connect(GetOutputDestInputXpt(dst), GetFrameBufferOutputXptFromChannel(channels[i]));
+            if (quadQuad)
+            {
+                re &= SetQuadQuadSquaresEnable(true, channels[i]);
+                re &= SetSDIOut12GEnable(channels[i], true);
+            }
+            else if (!separateSquares)
+                re &= Set4kSquaresEnable(true, channels[i]);
+            if (keyed)
+            {
+                re &= Set4kSquaresEnable(true, NTV2Channel(keyChannel + i));
+                re &= RouteKeyer(channels[i], NTV2Channel(keyChannel + i), NTV2Channel(keyerBackground + i), UWord(i), fmt, fbFmt);
+            }
+            else
+                re &= Connect(GetOutputDestInputXpt(dst), GetFrameBufferOutputXptFromChannel(channels[i]));
             break;
         default:
             return false;
@@ -658,6 +1008,8 @@ bool AJADevice::RouteSLInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt
     re &= (SetSDITransmitEnable(channel, false));
     re &= (SetEnableVANCData(false, false, channel));
     re &= (SetMode(channel, NTV2_MODE_INPUT));
+    if (NTV2DeviceCanDoRP188(ID))
+        SetRP188Mode(channel, NTV2_RP188_INPUT); // Not all inputs carry timecode, don't fail routing
     NTV2VideoFormat effectiveFormat = videoFmt;
     if (NTV2_VIDEO_FORMAT_IS_B(videoFmt))
     {
@@ -667,6 +1019,12 @@ bool AJADevice::RouteSLInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt
     }
     else
         re &= SetSDIInLevelBtoLevelAConversion(channel, false);
+    // UHD on a 12G link goes into one frame store, without the TSI muxes of quad links
+    if (NTV2_IS_QUAD_FRAME_FORMAT(effectiveFormat))
+    {
+        re &= SetQuadFrameEnable(true, channel);
+        re &= SetTsiFrameEnable(true, channel);
+    }
     re &= (SetVideoFormat(effectiveFormat, false, false, channel));
     re &= (SetFrameBufferFormat(channel, fbFmt));
     re &= (Connect(GetFrameBufferInputXptFromChannel(channel), GetInputSourceOutputXpt(src)));
@@ -675,10 +1033,28 @@ bool AJADevice::RouteSLInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt
     return re;
 }
 
-bool AJADevice::RouteSLOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt)
+bool AJADevice::RouteSLOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground)
 {
     std::unique_lock lock(ChannelsMutex);
     NTV2OutputDestination dst = NTV2ChannelToOutputDestination(channel);
+
+    const bool keyed = NTV2_IS_VALID_CHANNEL(keyerBackground);
+    const NTV2Channel keyChannel = GetKeyChannel(channel, false);
+    const bool is12G = NTV2_IS_QUAD_FRAME_FORMAT(videoFmt);
+    if (is12G && (keyed || !Can12G()))
+    {
+        nosEngine.LogE("Single link UHD outputs need a 12G device and can't be keyed");
+        return false;
+    }
+    if (keyed)
+    {
+        // Mixers work on frame store pairs: fill on the even channel, key on the odd one
+        if ((channel & 1) || channel / 2 >= NTV2DeviceGetNumMixers(ID) || Channels.contains(keyChannel))
+            return false;
+        auto bg = Channels.find(keyerBackground);
+        if (bg != Channels.end() && !bg->second)
+            return false;
+    }
             
     // Validate channel
     // AJA_ASSERT(ChannelCanOutput(channel));
@@ -690,15 +1066,76 @@ bool AJADevice::RouteSLOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFm
     re &= (SetSDITransmitEnable(channel, true));
     re &= (SetEnableVANCData(false, false, channel));
     re &= (SetMode(channel, NTV2_MODE_OUTPUT));
+    if (NTV2DeviceCanDoRP188(ID))
+        SetRP188Mode(channel, NTV2_RP188_OUTPUT);
+    if (is12G)
+    {
+        // The frame store feeds the SDI output directly, the link runs at 12G
+        re &= SetQuadFrameEnable(true, channel);
+        re &= SetTsiFrameEnable(true, channel);
+        re &= SetSDIOut12GEnable(channel, true);
+    }
     re &= (SetVideoFormat(videoFmt, false, false, channel));
     re &= (SetFrameBufferFormat(channel, fbFmt));
-    re &= (Connect(GetOutputDestInputXpt(dst), GetFrameBufferOutputXptFromChannel(channel), true));
+    if (keyed)
+        re &= RouteKeyer(channel, keyChannel, keyerBackground, UWord(channel / 2), videoFmt, fbFmt);
+    else
+        re &= (Connect(GetOutputDestInputXpt(dst), GetFrameBufferOutputXptFromChannel(channel), true));
     if(re) Channels[channel] = false;
     return re;
 }	
 
+bool AJADevice::RouteKeyer(NTV2Channel fillChannel, NTV2Channel keyChannel, NTV2Channel background, UWord mixer, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt)
+{
+    // Fill and key come from the frame stores, background straight from the SDI input
+    const auto mixerChannel = NTV2Channel(mixer);
+    const auto bgXpt = GetInputSourceOutputXpt(NTV2ChannelToInputSource(background, NTV2_INPUTSOURCES_SDI));
+    bool re = true;
+    re &= EnableChannel(keyChannel);
+    re &= SetMode(keyChannel, NTV2_MODE_OUTPUT);
+    re &= SetVideoFormat(videoFmt, false, false, keyChannel);
+    re &= SetFrameBufferFormat(keyChannel, fbFmt);
+    re &= SetSDITransmitEnable(background, false);
+    re &= Connect(GetMixerFGInputXpt(mixerChannel, false), GetFrameBufferOutputXptFromChannel(fillChannel));
+    re &= Connect(GetMixerFGInputXpt(mixerChannel, true), GetFrameBufferOutputXptFromChannel(keyChannel));
+    re &= Connect(GetMixerBGInputXpt(mixerChannel, false), bgXpt);
+    re &= Connect(GetMixerBGInputXpt(mixerChannel, true), bgXpt);
+    re &= SetMixerMode(mixer, NTV2MIXERMODE_FOREGROUND_ON);
+    re &= SetMixerFGInputControl(mixer, NTV2MIXERINPUTCONTROL_SHAPED);
+    re &= SetMixerBGInputControl(mixer, NTV2MIXERINPUTCONTROL_FULLRASTER);
+    re &= SetMixerVancOutputFromForeground(mixer, false);
+    re &= Connect(GetOutputDestInputXpt(NTV2ChannelToOutputDestination(fillChannel)), GetMixerOutputXptFromChannel(mixerChannel, false));
+    if (re)
+    {
+        Keyers[fillChannel] = {keyChannel, mixer};
+        Channels[keyChannel] = false;
+    }
+    return re;
+}
+
+void AJADevice::CloseKeyer(NTV2Channel fillChannel)
+{
+    auto it = Keyers.find(fillChannel);
+    if (it == Keyers.end())
+        return;
+    auto [keyChannel, mixer] = it->second;
+    const auto mixerChannel = NTV2Channel(mixer);
+    SetMixerMode(mixer, NTV2MIXERMODE_FOREGROUND_OFF);
+    Disconnect(GetMixerFGInputXpt(mixerChannel, false));
+    Disconnect(GetMixerFGInputXpt(mixerChannel, true));
+    Disconnect(GetMixerBGInputXpt(mixerChannel, false));
+    Disconnect(GetMixerBGInputXpt(mixerChannel, true));
+    Set4kSquaresEnable(false, keyChannel);
+    DisableChannel(keyChannel);
+    Channels.erase(keyChannel);
+    ClearCapturedFrames(keyChannel);
+    Keyers.erase(it);
+}
+
 void AJADevice::CloseChannel(NTV2Channel channel, bool isInput,  bool isQuad)
 {
+    if (!isInput)
+        DropBypass(channel, isQuad);
     std::unique_lock lock(ChannelsMutex);
     if (isQuad)
     {
@@ -722,10 +1159,26 @@ void AJADevice::CloseChannel(NTV2Channel channel, bool isInput,  bool isQuad)
 void AJADevice::CloseSLChannel(NTV2Channel channel, bool isInput)
 {
     AJA_ASSERT(Disconnect(isInput ? GetFrameBufferInputXptFromChannel(channel) : GetOutputDestInputXpt(NTV2ChannelToOutputDestination(channel))));
+    CloseAudio(channel);
     AJA_ASSERT(isInput ? UnsubscribeInputVerticalEvent(channel) : UnsubscribeOutputVerticalEvent(channel));
     AJA_ASSERT(isInput ? DisableInputInterrupt(channel) : DisableOutputInterrupt(channel));
     AJA_ASSERT(DisableChannel(channel));
+    bool quad = false;
+    if (GetQuadFrameEnable(quad, channel) && quad) // UHD on a 12G link
+    {
+        SetTsiFrameEnable(false, channel);
+        SetQuadFrameEnable(false, channel);
+        if (!isInput)
+            SetSDIOut12GEnable(channel, false);
+    }
+    if (!isInput)
+    {
+        CloseOutputQueue(channel);
+        CloseKeyer(channel);
+        CloseAncInsert(channel);
+    }
     Channels.erase(channel);
+    ClearCapturedFrames(channel);
 }
 
 
@@ -733,6 +1186,13 @@ void AJADevice::CloseQLChannel(NTV2Channel channel, bool isInput)
 {
     SetTsiFrameEnable(false, channel);
     Set4kSquaresEnable(false, channel);
+    if (Can12G())
+    {
+        SetQuadQuadSquaresEnable(false, channel);
+        SetQuadQuadFrameEnable(false, channel);
+        if (!isInput)
+            SetSDIOut12GEnable(channel, false);
+    }
     NTV2InputCrosspointID in;
     NTV2OutputCrosspointID out;
     GetTSIMUXPins(channel, in, out);
@@ -740,10 +1200,24 @@ void AJADevice::CloseQLChannel(NTV2Channel channel, bool isInput)
     Disconnect(GetOutputDestInputXpt(NTV2ChannelToOutputDestination(channel)));
     Disconnect(GetInputTSIFB(channel));
     Disconnect(GetFrameBufferInputXptFromChannel(channel));
+    CloseAudio(channel);
     AJA_ASSERT(isInput ? UnsubscribeInputVerticalEvent(channel) : UnsubscribeOutputVerticalEvent(channel));
     AJA_ASSERT(isInput ? DisableInputInterrupt(channel) : DisableOutputInterrupt(channel));
     AJA_ASSERT(DisableChannel(channel));
+    if (!isInput)
+    {
+        CloseOutputQueue(channel);
+        CloseKeyer(channel);
+        CloseAncInsert(channel);
+    }
     Channels.erase(channel);
+    ClearCapturedFrames(channel);
+}
+
+void AJADevice::CloseAncInsert(NTV2Channel channel)
+{
+    if (AncInsertEnabled[channel].exchange(false))
+        AncInsertSetEnable(UWord(channel), false);
 }
 
 void AJADevice::SendCheckConfigurationToNodes()
@@ -766,7 +1240,7 @@ bool AJADevice::GetExtent(NTV2VideoFormat fmt, Mode mode, uint32_t& width, uint3
 
     // we do this because input is most likely quad squares
     // and vpid can't tell us if the channel is a part of a multilink
-    if (IsQuad(mode) && !NTV2_IS_QUAD_FRAME_FORMAT(fmt))
+    if (IsQuad(mode) && !NTV2_IS_QUAD_FRAME_FORMAT(fmt) && !NTV2_IS_QUAD_QUAD_FORMAT(fmt))
     {
         width  *= 2;
         height *= 2;
@@ -774,7 +1248,15 @@ bool AJADevice::GetExtent(NTV2VideoFormat fmt, Mode mode, uint32_t& width, uint3
     return true;
 }
 
-bool AJADevice::RouteSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, bool isInput, Mode mode, NTV2FrameBufferFormat fbFmt)
+NTV2VideoFormat AJADevice::GetQuadQuadFormat(NTV2VideoFormat linkFmt)
+{
+    if (!NTV2_IS_QUAD_FRAME_FORMAT(linkFmt) || NTV2_IS_QUAD_QUAD_FORMAT(linkFmt))
+        return linkFmt;
+    auto fmt = GetFirstMatchingVideoFormat(GetNTV2FrameRateFromVideoFormat(linkFmt), UWord(GetDisplayHeight(linkFmt) * 2), UWord(GetDisplayWidth(linkFmt) * 2), false, false, false);
+    return NTV2_IS_QUAD_QUAD_FORMAT(fmt) ? fmt : linkFmt;
+}
+
+bool AJADevice::RouteSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, bool isInput, Mode mode, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground, bool separateSquares)
 {
     if (isInput)
     {
@@ -785,9 +1267,16 @@ bool AJADevice::RouteSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, bool
             GetExtent(channel, mode, w, h);
             videoFmt = GetFirstMatchingVideoFormat(GetNTV2FrameRateFromVideoFormat(videoFmt), h, w, false, false, false);
         }
+        else if (mode != SL)
+            videoFmt = GetQuadQuadFormat(videoFmt);
+    }
+    else
+    {
+        // The SDI outputs get their new source, what a bypass would restore is no longer valid
+        DropBypass(channel, IsQuad(mode));
     }
 
-    if (isInput ? RouteInputSignal(channel, videoFmt, mode, fbFmt) : RouteOutputSignal(channel, videoFmt, mode, fbFmt))
+    if (isInput ? RouteInputSignal(channel, videoFmt, mode, fbFmt, separateSquares) : RouteOutputSignal(channel, videoFmt, mode, fbFmt, keyerBackground, separateSquares))
     {
         if (NTV2_FRAMERATE_INVALID == FPSFamily || (isInput && (mode == Mode::SL && GetFilteredChannels(true).size() <= 1) || (mode != Mode::AUTO && GetFilteredChannels(true).size() <= 4)))
             FPSFamily = GetFrameRateFamily(GetNTV2FrameRateFromVideoFormat(videoFmt));
@@ -869,6 +1358,667 @@ bool AJADevice::WaitVBL(NTV2Channel channel, bool isInput, NTV2FieldID fieldId)
     }
 }
 
+bool AJADevice::WaitVBLHybrid(NTV2Channel channel, bool isInput, HybridWaitState& state, std::chrono::microseconds spinWindow, std::chrono::microseconds spinBudget)
+{
+    using namespace std::chrono;
+    auto readCount = [&](ULWord& count) {
+        return isInput ? GetInputVerticalInterruptCount(count, channel) : GetOutputVerticalInterruptCount(count, channel);
+    };
+    auto record = [&](steady_clock::time_point now, ULWord count) {
+        if (state.LastVBLCount && count > state.LastVBLCount)
+        {
+            double interval = double(duration_cast<nanoseconds>(now - state.LastVBL).count()) / (count - state.LastVBLCount);
+            // Wakeups from the interrupt wait are late by the wakeup latency, smoothing keeps them from skewing the period
+            state.PeriodNs = state.PeriodNs ? state.PeriodNs * 0.9 + interval * 0.1 : interval;
+        }
+        state.LastVBL = now;
+        state.LastVBLCount = count;
+    };
+    auto waitInterrupt = [&] {
+        state.UsedInterrupt = true;
+        if (!WaitVBL(channel, isInput, NTV2_FIELD_INVALID))
+            return false;
+        auto now = steady_clock::now();
+        ULWord count = 0;
+        readCount(count);
+        record(now, count);
+        return true;
+    };
+
+    state.PolledNs = 0;
+    state.UsedInterrupt = false;
+    ULWord count = 0;
+    if (!state.PeriodNs || !readCount(count) || count != state.LastVBLCount)
+        return waitInterrupt();
+
+    std::this_thread::sleep_until(state.LastVBL + nanoseconds(int64_t(state.PeriodNs)) - spinWindow);
+    const auto pollStart = steady_clock::now();
+    const auto deadline = pollStart + spinBudget;
+    while (readCount(count))
+    {
+        auto now = steady_clock::now();
+        state.PolledNs = duration_cast<nanoseconds>(now - pollStart).count();
+        if (count != state.LastVBLCount)
+        {
+            record(now, count);
+            return true;
+        }
+        if (now > deadline)
+            break;
+        std::this_thread::yield();
+    }
+    return waitInterrupt();
+}
+
+bool AJADevice::ShareCapturedFrame(NTV2Channel channel, ULWord vblCount, uint8_t* buffer, size_t size, CaptureFunction const& capture)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel) || !buffer)
+        return false;
+    auto& slot = CaptureCache[channel];
+    // Readers of the same VBL block here until the first one finishes its DMA
+    std::unique_lock lock(slot.Mutex);
+    if (slot.Latest.Data && slot.Latest.VBLCount == vblCount && slot.Latest.Size == size)
+    {
+        if (slot.Latest.Data != buffer)
+            memcpy(buffer, slot.Latest.Data, size);
+        return true;
+    }
+
+    CapturedFrame frame{.VBLCount = vblCount, .Data = buffer, .Size = size};
+    if (!capture(frame, slot.Latest.Data ? &slot.Latest : nullptr))
+    {
+        // The buffer may hold part of a frame now
+        if (slot.Latest.Data == buffer)
+            slot.Latest = {};
+        return false;
+    }
+    slot.Latest = frame;
+    return true;
+}
+
+void AJADevice::ClearCapturedFrames(NTV2Channel channel, const uint8_t* buffer)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel))
+        return;
+    auto& slot = CaptureCache[channel];
+    std::unique_lock lock(slot.Mutex);
+    if (!buffer || slot.Latest.Data == buffer)
+        slot.Latest = {};
+}
+
+void AJADevice::SetThreadPolicy(nos::aja::ThreadPolicy policy)
+{
+    std::sort(policy.ExcludedCpus.begin(), policy.ExcludedCpus.end());
+    std::unique_lock lock(ThreadPolicyMutex);
+    if (policy == CurrentThreadPolicy)
+        return;
+    CurrentThreadPolicy = std::move(policy);
+    ++ThreadPolicyGeneration;
+}
+
+void AJADevice::SetCrossRateOutputs(bool allow)
+{
+    if (allow && !CanDoMultiFormat())
+        nosEngine.LogW("AJA: %s can't run channels at independent formats, outputs stay in the frame rate family of the device", GetDisplayName().c_str());
+    if (CrossRateOutputs.exchange(allow) != allow)
+        SendCheckConfigurationToNodes();
+}
+
+bool AJADevice::CanDoMultiFormat()
+{
+    bool multiFormat = false;
+    return NTV2DeviceCanDoMultiFormat(ID) && GetMultiFormatMode(multiFormat) && multiFormat;
+}
+
+bool AJADevice::CanDoCrossRateOutputs()
+{
+    return CrossRateOutputs && CanDoMultiFormat();
+}
+
+void AJADevice::ApplyThreadPolicy(nos::aja::AppliedThreadPolicy& applied, std::string_view threadName)
+{
+    const uint32_t generation = ThreadPolicyGeneration;
+    const auto thread = std::this_thread::get_id();
+    if (applied.Generation == generation && applied.Thread == thread)
+        return;
+    nos::aja::ThreadPolicy policy;
+    {
+        std::unique_lock lock(ThreadPolicyMutex);
+        policy = CurrentThreadPolicy;
+    }
+    // Threads that never had a policy keep the scheduling they were created with until one is set
+    const bool isDefault = policy == nos::aja::ThreadPolicy{};
+    if (!isDefault || applied.Thread == thread)
+    {
+        auto errors = nos::aja::ApplyThreadPolicy(policy, NumaNode);
+        // Every thread of the card applies each policy, it is reported by the first one
+        if (LoggedThreadPolicyGeneration.exchange(generation) != generation)
+        {
+            if (!errors.empty())
+                nosEngine.LogW("AJA: %.*s: %s", int(threadName.size()), threadName.data(), errors.c_str());
+            else if (!isDefault)
+                nosEngine.LogI("AJA: %s threads: %s priority, %s", GetDisplayName().c_str(), policy.RealTime ? "Real-time" : "Normal",
+                               policy.PinToCardNode ? ("CPUs of NUMA node " + std::to_string(NumaNode)).c_str() : "any CPU");
+        }
+    }
+    applied.Generation = generation;
+    applied.Thread = thread;
+}
+
+std::shared_ptr<AJADevice::AudioStream> AJADevice::OpenAudio(NTV2Channel channel, bool isInput, uint32_t channelCount, uint32_t ringDepth)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel) || !ringDepth)
+        return nullptr;
+    const NTV2AudioSystem audioSystem = NTV2ChannelToAudioSystem(channel);
+    if (UWord(audioSystem) >= NTV2DeviceGetNumAudioSystems(ID))
+        return nullptr;
+    channelCount = std::min<uint32_t>(channelCount > 8 ? 16 : 8, NTV2DeviceGetMaxAudioChannels(ID));
+
+    std::unique_lock lock(AudioMutex);
+    if (AudioStreams[channel])
+        return nullptr;
+
+    bool ok = SetNumberAudioChannels(channelCount, audioSystem) && SetAudioRate(NTV2_AUDIO_48K, audioSystem) &&
+              SetAudioBufferSize(NTV2_AUDIO_BUFFER_BIG, audioSystem) && SetAudioLoopBack(NTV2_AUDIO_LOOPBACK_OFF, audioSystem);
+    if (isInput)
+        ok = ok && SetAudioSystemInputSource(audioSystem, NTV2_AUDIO_EMBEDDED, NTV2ChannelToEmbeddedAudioInput(channel)) &&
+             SetEmbeddedAudioClock(NTV2_EMBEDDED_AUDIO_CLOCK_VIDEO_INPUT, audioSystem);
+    else // Erase mode zeroes what the card played, so running out of samples plays silence instead of old audio
+        ok = ok && SetSDIOutputAudioSystem(channel, audioSystem) && SetAudioOutputEraseMode(audioSystem, true);
+
+    auto stream = std::make_shared<AudioStream>(channel, audioSystem, isInput, channelCount, ringDepth);
+    const ULWord frameBytes = channelCount * sizeof(int32_t);
+    ok = ok && GetAudioWrapAddress(stream->WrapAddress, audioSystem);
+    if (isInput)
+    {
+        ok = ok && GetAudioReadOffset(stream->CaptureOffset, audioSystem) && StartAudioInput(audioSystem) &&
+             ReadAudioLastIn(stream->CardOffset, audioSystem);
+    }
+    else
+    {
+        NTV2FrameRate frameRate = NTV2_FRAMERATE_INVALID;
+        ok = ok && GetFrameRate(frameRate, channel);
+        // Two frames ahead of the play head, so that a late wakeup doesn't starve the card
+        stream->LeadBytes = 2 * GetAudioSamplesPerFrame(frameRate, NTV2_AUDIO_48K) * frameBytes;
+        ok = ok && stream->LeadBytes && StartAudioOutput(audioSystem) && ReadAudioLastOut(stream->CardOffset, audioSystem);
+    }
+    if (!ok)
+    {
+        StopAudio(*stream);
+        nosEngine.LogE("AJA: Unable to start audio system %d for %s %d", int(audioSystem) + 1, isInput ? "input" : "output", int(channel) + 1);
+        return nullptr;
+    }
+    stream->CardOffset -= stream->CardOffset % frameBytes;
+    stream->Thread = std::thread([this, raw = stream.get()] { RunAudioStream(*raw); });
+    AudioStreams[channel] = stream;
+    return stream;
+}
+
+void AJADevice::CloseAudio(std::shared_ptr<AudioStream> const& stream)
+{
+    if (!stream)
+        return;
+    {
+        std::unique_lock lock(AudioMutex);
+        if (AudioStreams[stream->Channel] != stream)
+            return;
+        AudioStreams[stream->Channel] = nullptr;
+    }
+    StopAudio(*stream);
+}
+
+void AJADevice::CloseAudio(NTV2Channel channel)
+{
+    std::shared_ptr<AudioStream> stream;
+    {
+        std::unique_lock lock(AudioMutex);
+        stream = std::move(AudioStreams[channel]);
+    }
+    if (stream)
+        StopAudio(*stream);
+}
+
+void AJADevice::StopAudio(AudioStream& stream)
+{
+    stream.Stop = true;
+    if (stream.Thread.joinable())
+        stream.Thread.join();
+    if (stream.IsInput)
+        StopAudioInput(stream.AudioSystem);
+    else
+        StopAudioOutput(stream.AudioSystem);
+}
+
+void AJADevice::RunAudioStream(AudioStream& stream)
+{
+    nos::aja::AppliedThreadPolicy threadPolicy;
+    const std::string threadName = std::string("Audio ") + (stream.IsInput ? "In " : "Out ") + std::to_string(stream.Channel + 1);
+    while (!stream.Stop)
+    {
+        ApplyThreadPolicy(threadPolicy, threadName);
+        if (!(stream.IsInput ? WaitForInputVerticalInterrupt(stream.Channel) : WaitForOutputVerticalInterrupt(stream.Channel)))
+        {
+            // Channel is being closed or lost its signal
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (stream.IsInput)
+        {
+            ULWord vblCount = 0;
+            GetInputVerticalInterruptCount(vblCount, stream.Channel);
+            ReadAudioBlock(stream, vblCount);
+            {
+                std::unique_lock lock(stream.HandledMutex);
+                stream.HandledVBL = vblCount;
+            }
+            stream.Handled.notify_all();
+        }
+        else
+        {
+            WriteAudioBlocks(stream);
+        }
+    }
+}
+
+bool AJADevice::ReadAudioBlock(AudioStream& stream, ULWord vblCount)
+{
+    ULWord lastIn = 0;
+    if (!ReadAudioLastIn(lastIn, stream.AudioSystem))
+        return false;
+    const ULWord frameBytes = stream.Ring.GetChannelCount() * sizeof(int32_t);
+    lastIn -= lastIn % frameBytes;
+    ULWord bytes = (lastIn + stream.WrapAddress - stream.CardOffset) % stream.WrapAddress;
+    if (!bytes)
+        return true;
+    const ULWord maxBytes = stream.Ring.GetMaxSamples() * frameBytes;
+    if (bytes > maxBytes)
+    {
+        // The thread was held up for a while, keep the latest samples
+        const ULWord skipped = bytes - maxBytes;
+        stream.CardOffset = (stream.CardOffset + skipped) % stream.WrapAddress;
+        stream.SamplePosition += skipped / frameBytes;
+        stream.Discontinuity = true;
+        bytes = maxBytes;
+    }
+
+    auto* block = stream.Ring.BeginWrite();
+    bool ok = block != nullptr;
+    if (block)
+    {
+        auto* dst = reinterpret_cast<ULWord*>(block->Samples.data());
+        const ULWord first = std::min(bytes, stream.WrapAddress - stream.CardOffset);
+        ok = DMAReadAudio(stream.AudioSystem, dst, stream.CaptureOffset + stream.CardOffset, first) &&
+             (first == bytes || DMAReadAudio(stream.AudioSystem, dst + first / sizeof(ULWord), stream.CaptureOffset, bytes - first));
+    }
+    if (ok)
+    {
+        block->VBLCount = vblCount;
+        block->SamplePosition = stream.SamplePosition;
+        block->SampleCount = bytes / frameBytes;
+        block->Discontinuity = stream.Discontinuity;
+        stream.Ring.EndWrite();
+        stream.Discontinuity = false;
+    }
+    else
+    {
+        ++stream.Overruns;
+        stream.Discontinuity = true;
+    }
+    stream.CardOffset = (stream.CardOffset + bytes) % stream.WrapAddress;
+    stream.SamplePosition += bytes / frameBytes;
+    return ok;
+}
+
+bool AJADevice::WriteAudioBlocks(AudioStream& stream)
+{
+    ULWord playHead = 0;
+    if (!ReadAudioLastOut(playHead, stream.AudioSystem))
+        return false;
+    const ULWord frameBytes = stream.Ring.GetChannelCount() * sizeof(int32_t);
+    playHead -= playHead % frameBytes;
+    auto queued = [&] { return (stream.CardOffset + stream.WrapAddress - playHead) % stream.WrapAddress; };
+    if (queued() > stream.WrapAddress / 2)
+    {
+        // The play head passed what was written, continue right after it
+        stream.CardOffset = playHead;
+    }
+    while (queued() < stream.LeadBytes)
+    {
+        auto* block = stream.Ring.Peek();
+        if (!block)
+        {
+            // Nothing to play, what was played is already zero
+            if (stream.SamplePosition)
+                ++stream.Underruns;
+            stream.CardOffset = (playHead + stream.LeadBytes) % stream.WrapAddress;
+            return false;
+        }
+        const ULWord bytes = block->SampleCount * frameBytes;
+        auto* src = reinterpret_cast<const ULWord*>(block->Samples.data());
+        const ULWord first = std::min(bytes, stream.WrapAddress - stream.CardOffset);
+        bool ok = DMAWriteAudio(stream.AudioSystem, src, stream.CardOffset, first) &&
+                  (first == bytes || DMAWriteAudio(stream.AudioSystem, src + first / sizeof(ULWord), 0, bytes - first));
+        stream.CardOffset = (stream.CardOffset + bytes) % stream.WrapAddress;
+        stream.SamplePosition += block->SampleCount;
+        stream.Ring.Pop();
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+AJADevice::OutputQueue::OutputQueue(NTV2Channel channel, NTV2Channel keyChannel, bool isQuad, std::vector<ULWord> fillFrames, std::vector<ULWord> keyFrames, uint8_t shownStore)
+    : Channel(channel), KeyChannel(keyChannel), IsQuad(isQuad), FillFrames(std::move(fillFrames)), KeyFrames(std::move(keyFrames)), Shown(shownStore)
+{
+    for (uint8_t store = 0; store < FillFrames.size(); ++store)
+        if (store != shownStore)
+            FreeStores.push_back(store);
+}
+
+std::optional<uint8_t> AJADevice::OutputQueue::AcquireStore(std::chrono::milliseconds timeout)
+{
+    std::unique_lock lock(Mutex);
+    if (!StoreFreed.wait_for(lock, timeout, [this] { return Stop || !FreeStores.empty(); }) || Stop)
+        return std::nullopt;
+    uint8_t store = FreeStores.back();
+    FreeStores.pop_back();
+    return store;
+}
+
+void AJADevice::OutputQueue::ReleaseStore(uint8_t store)
+{
+    {
+        std::unique_lock lock(Mutex);
+        FreeStores.push_back(store);
+    }
+    StoreFreed.notify_one();
+}
+
+void AJADevice::OutputQueue::Push(Frame frame)
+{
+    std::unique_lock lock(Mutex);
+    auto it = std::upper_bound(Pending.begin(), Pending.end(), frame.TargetVBL, [](ULWord target, Frame const& queued) { return target < queued.TargetVBL; });
+    Pending.insert(it, std::move(frame));
+}
+
+size_t AJADevice::OutputQueue::GetQueuedCount()
+{
+    std::unique_lock lock(Mutex);
+    return Pending.size();
+}
+
+std::shared_ptr<AJADevice::OutputQueue> AJADevice::OpenOutputQueue(NTV2Channel channel, NTV2Channel keyChannel, bool isQuad, std::vector<ULWord> fillFrames, std::vector<ULWord> keyFrames, uint8_t shownStore)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel) || fillFrames.size() < 3 || fillFrames.size() > 255 || shownStore >= fillFrames.size() ||
+        (!keyFrames.empty() && keyFrames.size() != fillFrames.size()))
+        return nullptr;
+    std::unique_lock lock(OutputQueuesMutex);
+    if (OutputQueues[channel])
+        return nullptr;
+    auto queue = std::make_shared<OutputQueue>(channel, keyChannel, isQuad, std::move(fillFrames), std::move(keyFrames), shownStore);
+    queue->Thread = std::thread([this, raw = queue.get()] { RunOutputQueue(*raw); });
+    OutputQueues[channel] = queue;
+    return queue;
+}
+
+void AJADevice::CloseOutputQueue(std::shared_ptr<OutputQueue> const& queue)
+{
+    if (!queue)
+        return;
+    {
+        std::unique_lock lock(OutputQueuesMutex);
+        if (OutputQueues[queue->Channel] != queue)
+            return;
+        OutputQueues[queue->Channel] = nullptr;
+    }
+    StopOutputQueue(*queue);
+}
+
+void AJADevice::CloseOutputQueue(NTV2Channel channel)
+{
+    std::shared_ptr<OutputQueue> queue;
+    {
+        std::unique_lock lock(OutputQueuesMutex);
+        queue = std::move(OutputQueues[channel]);
+    }
+    if (queue)
+        StopOutputQueue(*queue);
+}
+
+void AJADevice::StopOutputQueue(OutputQueue& queue)
+{
+    {
+        std::unique_lock lock(queue.Mutex);
+        queue.Stop = true;
+    }
+    queue.StoreFreed.notify_all();
+    if (queue.Thread.joinable())
+        queue.Thread.join();
+}
+
+void AJADevice::RunOutputQueue(OutputQueue& queue)
+{
+    nos::aja::AppliedThreadPolicy threadPolicy;
+    const std::string threadName = "Output Queue " + std::to_string(queue.Channel + 1);
+    while (!queue.Stop)
+    {
+        ApplyThreadPolicy(threadPolicy, threadName);
+        if (!WaitForOutputVerticalInterrupt(queue.Channel))
+        {
+            // Channel is being closed
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        ULWord vblCount = 0;
+        GetOutputVerticalInterruptCount(vblCount, queue.Channel);
+
+        std::optional<OutputQueue::Frame> flip;
+        bool freed = false;
+        {
+            std::unique_lock lock(queue.Mutex);
+            if (queue.Retiring >= 0)
+            {
+                queue.FreeStores.push_back(uint8_t(queue.Retiring));
+                queue.Retiring = -1;
+                freed = true;
+            }
+            // A flip now takes effect at the next VBL. Of the frames due by then only the latest goes out.
+            while (!queue.Pending.empty() && queue.Pending.front().TargetVBL <= vblCount + 1)
+            {
+                if (flip)
+                {
+                    queue.FreeStores.push_back(flip->Store);
+                    ++queue.LateFrames;
+                    freed = true;
+                }
+                flip = std::move(queue.Pending.front());
+                queue.Pending.pop_front();
+            }
+            if (flip)
+            {
+                if (flip->TargetVBL <= vblCount)
+                    ++queue.LateFrames;
+                queue.Retiring = queue.Shown;
+                queue.Shown = flip->Store;
+            }
+        }
+        if (freed)
+            queue.StoreFreed.notify_all();
+        if (!flip)
+            continue;
+        WriteOutputFrameState(queue.Channel, queue.IsQuad, queue.FillFrames[flip->Store], flip->Timecode ? &*flip->Timecode : nullptr);
+        if (!queue.KeyFrames.empty())
+            WriteOutputFrameState(queue.KeyChannel, queue.IsQuad, queue.KeyFrames[flip->Store], nullptr);
+    }
+}
+
+uint32_t AJADevice::AddInputSignalListener(NTV2Channel channel, uint32_t stableFrames, InputSignalListener listener)
+{
+    if (!NTV2_IS_VALID_CHANNEL(channel) || !listener)
+        return 0;
+    std::unique_lock lock(InputSignalMonitor.Mutex);
+    const uint32_t id = InputSignalMonitor.NextID++;
+    InputSignalMonitor.Watches[id] = {channel, std::max(stableFrames, 1u), std::move(listener)};
+    if (!InputSignalMonitor.Thread.joinable())
+        InputSignalMonitor.Thread = std::thread([this] { RunInputSignalMonitor(); });
+    InputSignalMonitor.Changed.notify_all();
+    return id;
+}
+
+void AJADevice::RemoveInputSignalListener(uint32_t id)
+{
+    std::unique_lock lock(InputSignalMonitor.Mutex);
+    InputSignalMonitor.Watches.erase(id);
+    // A listener removing itself is already on the monitor thread, its call returns after this
+    if (std::this_thread::get_id() != InputSignalMonitor.Thread.get_id())
+        InputSignalMonitor.Changed.wait(lock, [this, id] { return InputSignalMonitor.CallingID != id; });
+}
+
+void AJADevice::StopInputSignalMonitor()
+{
+    {
+        std::unique_lock lock(InputSignalMonitor.Mutex);
+        InputSignalMonitor.Stop = true;
+    }
+    InputSignalMonitor.Changed.notify_all();
+    if (InputSignalMonitor.Thread.joinable())
+        InputSignalMonitor.Thread.join();
+}
+
+void AJADevice::RunInputSignalMonitor()
+{
+    // Shorter than a field at any rate, so a change settles within a poll of its last stable frame
+    constexpr auto PollInterval = std::chrono::milliseconds(5);
+    std::unordered_map<NTV2Channel, nos::aja::SignalDebouncer> debouncers;
+    std::unique_lock lock(InputSignalMonitor.Mutex);
+    while (!InputSignalMonitor.Stop)
+    {
+        if (InputSignalMonitor.Watches.empty())
+        {
+            debouncers.clear();
+            InputSignalMonitor.Changed.wait(lock, [this] { return InputSignalMonitor.Stop || !InputSignalMonitor.Watches.empty(); });
+            continue;
+        }
+        std::unordered_map<NTV2Channel, uint32_t> stableFrames;
+        for (auto& [id, watch] : InputSignalMonitor.Watches)
+            stableFrames[watch.Channel] = std::max(stableFrames[watch.Channel], watch.StableFrames);
+        std::erase_if(debouncers, [&](auto const& entry) { return !stableFrames.contains(entry.first); });
+
+        // Registers are read without the lock, so that listeners can be added and removed meanwhile
+        lock.unlock();
+        std::vector<InputSignalChange> changes;
+        for (auto [channel, frames] : stableFrames)
+        {
+            ULWord vpidA = 0, vpidB = 0;
+            ReadSDIInVPID(channel, vpidA, vpidB);
+            const NTV2VideoFormat format = GetSDIInputVideoFormat(channel);
+            const uint64_t nowNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+            auto& debouncer = debouncers[channel];
+            // Frames of the new signal, or of the old one while there is none
+            NTV2VideoFormat rateFormat = NTV2_IS_VALID_VIDEO_FORMAT(format) ? format : NTV2VideoFormat(debouncer.GetSettled().Format);
+            const double fps = NTV2_IS_VALID_VIDEO_FORMAT(rateFormat) ? GetFramesPerSecond(GetNTV2FrameRateFromVideoFormat(rateFormat)) : 25.0;
+            const uint64_t stableNs = uint64_t(frames * 1e9 / std::max(fps, 1.0));
+            if (debouncer.Update({uint32_t(format), vpidA}, nowNs, stableNs))
+            {
+                auto settled = debouncer.GetSettled();
+                changes.push_back({channel, NTV2VideoFormat(settled.Format), settled.VPID, debouncer.GetChangeStartNs(), nowNs, debouncer.GetFlaps()});
+            }
+        }
+        lock.lock();
+
+        // Listeners are called without the lock, so that they can add and remove listeners
+        for (auto& change : changes)
+        {
+            std::vector<uint32_t> ids;
+            for (auto& [id, watch] : InputSignalMonitor.Watches)
+                if (watch.Channel == change.Channel)
+                    ids.push_back(id);
+            for (auto id : ids)
+            {
+                // Removed by an earlier listener
+                auto it = InputSignalMonitor.Watches.find(id);
+                if (it == InputSignalMonitor.Watches.end())
+                    continue;
+                auto listener = it->second.Listener;
+                InputSignalMonitor.CallingID = id;
+                lock.unlock();
+                listener(change);
+                lock.lock();
+                InputSignalMonitor.CallingID = 0;
+                InputSignalMonitor.Changed.notify_all();
+            }
+        }
+        InputSignalMonitor.Changed.wait_for(lock, PollInterval, [this] { return InputSignalMonitor.Stop; });
+    }
+}
+
+uint64_t AJADevice::GetVideoMemorySize()
+{
+    // Audio buffers are at the top of the card memory, 8 MiB for each audio system
+    const uint64_t memorySize = NTV2DeviceGetActiveMemorySize(ID);
+    const uint64_t audioSize = uint64_t(NTV2DeviceGetNumAudioSystems(ID)) * 8 * 1024 * 1024;
+    return memorySize > audioSize ? memorySize - audioSize : 0;
+}
+
+bool AJADevice::SetBypass(NTV2Channel inputChannel, NTV2Channel outputChannel, bool isQuad, bool engage)
+{
+    const u32 linkCount = isQuad ? 4 : 1;
+    if (isQuad && ((inputChannel & 3) || (outputChannel & 3)))
+        return false;
+
+    {
+        std::shared_lock lock(ChannelsMutex);
+        for (u32 i = 0; i < linkCount; ++i)
+        {
+            auto out = Channels.find(NTV2Channel(outputChannel + i));
+            if (out == Channels.end() || out->second)
+                return false; // Output links have to be open as outputs
+            auto in = Channels.find(NTV2Channel(inputChannel + i));
+            if (in != Channels.end() && !in->second)
+                return false; // Input links can't be transmitting
+        }
+    }
+
+    std::unique_lock lock(BypassMutex);
+    bool re = true;
+    for (u32 i = 0; i < linkCount; ++i)
+    {
+        auto in = NTV2Channel(inputChannel + i);
+        auto out = NTV2Channel(outputChannel + i);
+        auto dstXpt = GetOutputDestInputXpt(NTV2ChannelToOutputDestination(out));
+        if (engage)
+        {
+            if (!BypassRestore.contains(out))
+            {
+                NTV2OutputCrosspointID current = NTV2_XptBlack;
+                GetConnectedOutput(dstXpt, current);
+                BypassRestore[out] = current;
+            }
+            re &= SetSDITransmitEnable(in, false);
+            re &= Connect(dstXpt, GetInputSourceOutputXpt(NTV2ChannelToInputSource(in, NTV2_INPUTSOURCES_SDI)));
+        }
+        else if (auto it = BypassRestore.find(out); it != BypassRestore.end())
+        {
+            re &= Connect(dstXpt, it->second);
+            BypassRestore.erase(it);
+        }
+    }
+    return re;
+}
+
+void AJADevice::DropBypass(NTV2Channel outputChannel, bool isQuad)
+{
+    std::unique_lock lock(BypassMutex);
+    for (u32 i = outputChannel; i < outputChannel + (isQuad ? 4u : 1u); ++i)
+        BypassRestore.erase(NTV2Channel(i));
+}
+
+bool AJADevice::IsBypassed(NTV2Channel outputChannel)
+{
+    std::unique_lock lock(BypassMutex);
+    return BypassRestore.contains(outputChannel);
+}
+
 void AJADevice::RegisterNode(nosUUID id)
 {
     std::unique_lock lock(RegisteredNodesMutex);
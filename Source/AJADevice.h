@@ -15,14 +15,27 @@
 
 #include "ntv2publicinterface.h"
 #include "ntv2vpid.h"
+#include "ancillarylist.h"
 
 // stl
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
+#include <optional>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
 #include <Nodos/PluginHelpers.hpp>
 
+#include "AudioRing.h"
+#include "BufferingController.h"
+#include "SignalDebouncer.h"
+#include "ThreadPolicy.h"
+
 #define AJA_ASSERT(x) { if(!(x)) { printf("%s:%d\n", __FILE__, __LINE__); abort();} }
 
 struct RestartParams {
@@ -52,12 +65,18 @@ struct AJADevice : CNTV2Card
         }
     }
     
+    // Boards are opened when first used, and in parallel when several are asked for at once. Guarded by DevicesMutex.
     inline static std::unordered_map<uint64_t, std::shared_ptr<AJADevice>> Devices;
-   
+    inline static std::unordered_map<uint64_t, std::shared_future<std::shared_ptr<AJADevice>>> OpeningDevices;
+    inline static std::mutex DevicesMutex;
 
     NTV2FrameRate FPSFamily = NTV2_FRAMERATE_INVALID;
+    // Outputs may run at rates of another family than FPSFamily, fed through a cadence (DMA Write's Render Rate)
+    std::atomic_bool CrossRateOutputs = false;
 
     NTV2DeviceID ID;
+    // False if the constructor could not open or set up the board, such devices are not registered
+    bool IsInitialized() const { return Initialized; }
 
     std::shared_mutex ChannelsMutex;
     //Channel To IsInput
@@ -68,6 +87,8 @@ struct AJADevice : CNTV2Card
     std::atomic_bool HasOutput = false;
 
     static std::map<std::string, uint64_t>  EnumerateDevices();
+    // Scans the boards again, for boards plugged in since, and lets boards that failed to open be tried again
+    static std::map<std::string, uint64_t> RefreshDevices();
     static std::unordered_map<std::string, std::set<NTV2VideoFormat>> StringToFormat();
 
     static std::map<std::string, uint64_t> AvailableDevices;
@@ -85,11 +106,20 @@ struct AJADevice : CNTV2Card
     static uint64_t FindDeviceSerial(const char* ident);
     static bool DeviceAvailable(const char* ident, bool input);
     static bool GetAvailableDevice(bool input, AJADevice** = 0);
+    // Enumerates the boards, none of them is opened until a node asks for it
     static void Init();
     static void Deinit();
+    // Starts opening the board in the background, GetDevice waits for it
+    static void OpenAsync(std::string const& name);
+    // Sorted by board index
+    static std::vector<std::shared_ptr<AJADevice>> GetOpenDevices();
+    // Opens the board if it is not open yet
     static std::shared_ptr<AJADevice> GetDevice(std::string const& name);
     static std::shared_ptr<AJADevice> GetDevice(uint32_t index);
+    // Never opens a board, so that it can be called every frame. Waits for a board that is being opened.
 	static std::shared_ptr<AJADevice> GetDeviceBySerialNumber(uint64_t serial);
+    // Opens the board if it is not open yet and waits for it, null if it could not be opened
+    static std::shared_ptr<AJADevice> OpenDevice(uint64_t serial);
 
     static NTV2ReferenceSource ChannelToRefSrc(NTV2Channel channel)
     {
@@ -115,8 +145,27 @@ struct AJADevice : CNTV2Card
 	bool CanMakeQuadOutputFromChannel(NTV2Channel channel);
 
     uint64_t GetLastInputVerticalInterruptTimestamp(NTV2Channel channel);
+    uint64_t GetLastOutputVerticalInterruptTimestamp(NTV2Channel channel);
+
+    // State of an input latched at its last VBL
+    struct InputFrameInfo {
+        uint64_t TimestampNs = 0;
+        NTV2_RP188 Timecode; // Invalid if the device or the signal has no RP188
+    };
+    bool ReadInputFrameInfo(NTV2Channel channel, InputFrameInfo& info);
+    // Text ("hh:mm:ss:ff") and frame count since midnight of an RP188 timecode
+    static bool DecodeTimecode(NTV2_RP188 const& timecode, NTV2VideoFormat videoFmt, std::string& text, uint32_t& frameCount);
+    static bool EncodeTimecode(std::string const& text, NTV2VideoFormat videoFmt, NTV2_RP188& timecode);
+
+    // Flips an output to a frame store and/or sets its RP188 timecode with one register batch. Quad outputs update all four links,
+    // link i goes to frame + i * linkFrameStep when the links have separate frame stores.
+    bool WriteOutputFrameState(NTV2Channel channel, bool isQuad, std::optional<ULWord> frame, NTV2_RP188 const* timecode, ULWord linkFrameStep = 0);
+    // Transfers ANC packets into the ANC region of a frame store, they are inserted when the frame goes out
+    bool WriteOutputAnc(NTV2Channel channel, ULWord frame, AJAAncillaryList& packets, NTV2VideoFormat videoFmt);
+    void CloseAncInsert(NTV2Channel channel);
     
-    bool RouteSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, bool isInput, Mode mode, NTV2FrameBufferFormat fbFmt);
+    // separateSquares: squares mode without a quad frame store, each link has its own frame store for its quadrant
+    bool RouteSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, bool isInput, Mode mode, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground = NTV2_CHANNEL_INVALID, bool separateSquares = false);
 
     void CloseChannel(NTV2Channel channel, bool isInput, bool isQuad);
 
@@ -126,6 +175,16 @@ struct AJADevice : CNTV2Card
 
     bool GetExtent(NTV2Channel channel, Mode mode, uint32_t& width, uint32_t& height);
     bool GetExtent(NTV2VideoFormat fmt, Mode mode, uint32_t& width, uint32_t& height);
+    // 8K format made of four links of a UHD or 4K format, other formats are returned as they are
+    static NTV2VideoFormat GetQuadQuadFormat(NTV2VideoFormat linkFmt);
+    // UHD on one 12G link, and 8K on four
+    bool Can12G() const { return NTV2DeviceCanDo12gRouting(ID); }
+
+    // Key frame stores are next to the fill frame stores: channel + 1 for single link, channel + 4 for quad link
+    static NTV2Channel GetKeyChannel(NTV2Channel fillChannel, bool isQuad)
+    {
+        return NTV2Channel(fillChannel + (isQuad ? 4 : 1));
+    }
 
     void GetReferenceAndFrameRate(NTV2ReferenceSource& reference, NTV2FrameRate& framerate);
 
@@ -139,29 +198,197 @@ struct AJADevice : CNTV2Card
 
     std::unordered_set<NTV2Channel> GetFilteredChannels(bool isInput);
     bool WaitVBL(NTV2Channel, bool isInput, NTV2FieldID fieldId);
+
+    // State of a sleep-then-poll waiter, kept by the caller between VBLs
+    struct HybridWaitState
+    {
+        std::chrono::steady_clock::time_point LastVBL; // When the counter was seen moving
+        ULWord LastVBLCount = 0;
+        double PeriodNs = 0; // Smoothed time between VBLs, learned from the counter
+        uint64_t PolledNs = 0; // Time spent polling in the last wait
+        bool UsedInterrupt = false; // Last wait fell back to the interrupt wait
+    };
+    // Sleeps until spinWindow before the predicted VBL, then polls the VBL counter until it advances. Falls back to
+    // the interrupt wait when there is no prediction yet, a VBL was missed or the counter doesn't move within spinBudget.
+    // Waits for frames, not fields.
+    bool WaitVBLHybrid(NTV2Channel channel, bool isInput, HybridWaitState& state, std::chrono::microseconds spinWindow, std::chrono::microseconds spinBudget);
     bool CheckFirmware(std::string& msg);
+
+    // A frame captured from a channel into the buffer of the reader that captured it, shared by all readers of that
+    // channel in the same VBL
+    struct CapturedFrame
+    {
+        ULWord VBLCount = 0;
+        // Frame store state of the reader that captured the frame, so that the next capture can continue from it
+        uint8_t DoubleBufferIdx = 0;
+        ULWord NextVBL = 0;
+        const uint8_t* Data = nullptr;
+        size_t Size = 0;
+    };
+    using CaptureFunction = std::function<bool(CapturedFrame& frame, CapturedFrame const* previous)>;
+    // Fills buffer with the frame of vblCount. The first reader of a VBL calls capture to DMA straight into its buffer,
+    // later readers copy from there. Copies and captures hold the channel's lock, so the first reader's next capture
+    // can't overwrite the frame while it is copied.
+    bool ShareCapturedFrame(NTV2Channel channel, ULWord vblCount, uint8_t* buffer, size_t size, CaptureFunction const& capture);
+    // Forgets the shared frame of the channel, only if it is in buffer when buffer is given
+    void ClearCapturedFrames(NTV2Channel channel, const uint8_t* buffer = nullptr);
+
+    // NUMA node the card is attached to, -1 if unknown
+    int GetNumaNode() const { return NumaNode; }
+
+    // Scheduling of the threads that wait for VBLs and transfer frames of this card. Threads pick it up the next
+    // time they call ApplyThreadPolicy. Only long-lived threads call it: the path threads through Wait VBL, and the
+    // audio, output queue and batch DMA threads of the plugin.
+    void SetThreadPolicy(nos::aja::ThreadPolicy policy);
+    // Lets outputs pick frame rates outside FPSFamily, nodes are asked to recheck their frame rate lists.
+    // Has an effect only on devices in multi-format mode, where each channel runs its own format.
+    void SetCrossRateOutputs(bool allow);
+    bool CanDoMultiFormat();
+    bool CanDoCrossRateOutputs();
+    // Applies the policy to the calling thread if it or the thread changed since the last call with applied
+    void ApplyThreadPolicy(nos::aja::AppliedThreadPolicy& applied, std::string_view threadName);
+
+    // Embedded audio of a channel. A thread woken by the VBLs of the channel moves it between the card's audio buffer
+    // and the ring, so blocks line up with the VBL counter and don't depend on when the node executes.
+    struct AudioStream
+    {
+        AudioStream(NTV2Channel channel, NTV2AudioSystem audioSystem, bool isInput, uint32_t channelCount, uint32_t ringDepth)
+            : Channel(channel), AudioSystem(audioSystem), IsInput(isInput), Ring(ringDepth, channelCount, MaxAudioBlockSamples)
+        {
+        }
+        const NTV2Channel Channel;
+        const NTV2AudioSystem AudioSystem;
+        const bool IsInput;
+        nos::aja::AudioRing Ring; // Input: filled by the thread. Output: drained by the thread.
+        std::atomic<uint64_t> Overruns = 0; // Input blocks lost because the ring was full
+        std::atomic<uint64_t> Underruns = 0; // Times the output ran out of blocks and silence was sent
+        std::atomic_bool Stop = false;
+        std::thread Thread;
+        // Input: last VBL the thread is done with, the node waits on Handled for the block of its VBL instead of polling
+        std::mutex HandledMutex;
+        std::condition_variable Handled;
+        uint32_t HandledVBL = 0;
+
+        // Used only by the thread
+        ULWord WrapAddress = 0; // Size of the input or output part of the card's audio buffer
+        ULWord CaptureOffset = 0; // Start of the input part
+        ULWord CardOffset = 0; // Next byte to read (input) or write (output), relative to its part
+        ULWord LeadBytes = 0; // Output: how far ahead of the play head the thread keeps the card's buffer filled
+        uint64_t SamplePosition = 0;
+        bool Discontinuity = false;
+    };
+    static constexpr uint32_t AudioSampleRate = 48000;
+    static constexpr uint32_t MaxAudioBlockSamples = 8192; // Covers a few VBLs at the slowest frame rate, in case the thread is late
+
+    // Configures the audio system of the channel (8 or 16 channels of 48 kHz embedded audio) and starts its thread.
+    // Fails if the channel has no audio system or someone else already opened it.
+    std::shared_ptr<AudioStream> OpenAudio(NTV2Channel channel, bool isInput, uint32_t channelCount, uint32_t ringDepth);
+    void CloseAudio(std::shared_ptr<AudioStream> const& stream);
+
+    // Frames of an output transferred ahead of their VBL. A thread woken by the VBLs of the output flips to each frame
+    // store one VBL before its target, so the frame goes out exactly at the target VBL.
+    struct OutputQueue
+    {
+        struct Frame
+        {
+            uint8_t Store = 0;
+            ULWord TargetVBL = 0;
+            std::optional<NTV2_RP188> Timecode;
+        };
+        // fillFrames and keyFrames are the card frame indices of each store, keyFrames is empty without a key
+        OutputQueue(NTV2Channel channel, NTV2Channel keyChannel, bool isQuad, std::vector<ULWord> fillFrames, std::vector<ULWord> keyFrames, uint8_t shownStore);
+        // A store no frame is queued in or going out from, nullopt on timeout or when the queue is closed
+        std::optional<uint8_t> AcquireStore(std::chrono::milliseconds timeout);
+        // Returns a store acquired for a frame that is not queued after all
+        void ReleaseStore(uint8_t store);
+        void Push(Frame frame);
+        size_t GetQueuedCount();
+        uint32_t GetStoreCount() const { return uint32_t(FillFrames.size()); }
+
+        const NTV2Channel Channel;
+        const NTV2Channel KeyChannel;
+        const bool IsQuad;
+        const std::vector<ULWord> FillFrames;
+        const std::vector<ULWord> KeyFrames;
+        std::atomic<uint64_t> LateFrames = 0; // Went out after their target VBL or were replaced by a later frame
+        std::atomic_bool Stop = false;
+        std::thread Thread;
+
+        std::mutex Mutex;
+        std::condition_variable StoreFreed;
+        std::deque<Frame> Pending; // By target VBL
+        std::vector<uint8_t> FreeStores;
+        int Shown = -1; // Store on air
+        int Retiring = -1; // Store on air until the next VBL
+    };
+    // Starts the thread that flips the output to queued frames. Fails if the channel already has a queue.
+    std::shared_ptr<OutputQueue> OpenOutputQueue(NTV2Channel channel, NTV2Channel keyChannel, bool isQuad, std::vector<ULWord> fillFrames, std::vector<ULWord> keyFrames, uint8_t shownStore);
+    void CloseOutputQueue(std::shared_ptr<OutputQueue> const& queue);
+
+    // Card memory below the audio buffers, frame stores have to fit in it
+    uint64_t GetVideoMemorySize();
+
+    // Depth of the buffer ring in front of an output, fed by the output's DMA node
+    nos::aja::BufferingController& GetBufferingController(NTV2Channel channel) { return BufferingControllers[channel]; }
+
+    // Routes SDI inputs straight to SDI outputs, bypassing the frame stores. Releasing restores the previous routing of the outputs.
+    bool SetBypass(NTV2Channel inputChannel, NTV2Channel outputChannel, bool isQuad, bool engage);
+    bool IsBypassed(NTV2Channel outputChannel);
+    // Forgets the bypass of the output links without touching the routing, for when they are re-routed or closed
+    void DropBypass(NTV2Channel outputChannel, bool isQuad);
+
+    // A settled change of an input's signal
+    struct InputSignalChange
+    {
+        NTV2Channel Channel = NTV2_CHANNEL_INVALID;
+        NTV2VideoFormat Format = NTV2_FORMAT_UNKNOWN; // Of the SDI input, unknown when the signal is lost
+        ULWord VPID = 0;
+        uint64_t ChangeStartNs = 0; // steady_clock, when the signal first left its previous state
+        uint64_t SettledNs = 0; // steady_clock, when the new signal had held for long enough
+        uint32_t Flaps = 0; // Signals seen and abandoned in between
+    };
+    using InputSignalListener = std::function<void(InputSignalChange const&)>;
+    // A thread polls the SDI format and VPID of inputs that have listeners, and calls them once per change after the
+    // new signal held for stableFrames frames. Listeners are called on that thread, never after they are removed.
+    uint32_t AddInputSignalListener(NTV2Channel channel, uint32_t stableFrames, InputSignalListener listener);
+    void RemoveInputSignalListener(uint32_t id);
 private:
     bool RouteSLInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt);
-    bool RouteSLOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt);
+    bool RouteSLOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground);
 
-    bool RouteQuadInputSignal (NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt);
-    bool RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt);
+    bool RouteQuadInputSignal (NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt, bool separateSquares);
+    bool RouteQuadOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground, bool separateSquares);
 
-    bool RouteInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt)
+    bool RouteInputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt, bool separateSquares)
     {
-        return (mode != SL) ? RouteQuadInputSignal(channel, videoFmt, mode, fbFmt) : RouteSLInputSignal(channel, videoFmt, fbFmt);
+        return (mode != SL) ? RouteQuadInputSignal(channel, videoFmt, mode, fbFmt, separateSquares) : RouteSLInputSignal(channel, videoFmt, fbFmt);
     }
 
-    bool RouteOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt)
+    bool RouteOutputSignal(NTV2Channel channel, NTV2VideoFormat videoFmt, Mode mode, NTV2FrameBufferFormat fbFmt, NTV2Channel keyerBackground, bool separateSquares)
     {
-        return (mode != SL) ? RouteQuadOutputSignal(channel, videoFmt, mode, fbFmt) : RouteSLOutputSignal(channel, videoFmt, fbFmt);
+        return (mode != SL) ? RouteQuadOutputSignal(channel, videoFmt, mode, fbFmt, keyerBackground, separateSquares) : RouteSLOutputSignal(channel, videoFmt, fbFmt, keyerBackground);
     }
 
+    // Sets up the key frame store and routes fill, key and background through the mixer to the SDI output of the link
+    bool RouteKeyer(NTV2Channel fillChannel, NTV2Channel keyChannel, NTV2Channel background, UWord mixer, NTV2VideoFormat videoFmt, NTV2FrameBufferFormat fbFmt);
+    void CloseKeyer(NTV2Channel fillChannel);
+
     void CloseSLChannel(NTV2Channel channel, bool isInput);
     void CloseQLChannel(NTV2Channel channel, bool isInput);
 
     void SendCheckConfigurationToNodes();
 
+    void RunAudioStream(AudioStream& stream);
+    bool ReadAudioBlock(AudioStream& stream, ULWord vblCount);
+    bool WriteAudioBlocks(AudioStream& stream);
+    void StopAudio(AudioStream& stream);
+    void CloseAudio(NTV2Channel channel);
+    void RunOutputQueue(OutputQueue& queue);
+    void StopOutputQueue(OutputQueue& queue);
+    void CloseOutputQueue(NTV2Channel channel);
+    void RunInputSignalMonitor();
+    void StopInputSignalMonitor();
+
     struct {
         std::unordered_map<uint32_t, std::function<void(NTV2ReferenceSource)>> Map;
         uint32_t NextID = 0;
@@ -170,6 +397,55 @@ private:
 
     std::mutex RegisteredNodesMutex;
     std::unordered_set<nosUUID> RegisteredNodes;
+
+    struct CaptureSlot {
+        std::mutex Mutex;
+        CapturedFrame Latest;
+    };
+    std::array<CaptureSlot, NTV2_MAX_NUM_CHANNELS> CaptureCache;
+    int NumaNode = -1;
+
+    std::mutex ThreadPolicyMutex;
+    nos::aja::ThreadPolicy CurrentThreadPolicy;
+    std::atomic<uint32_t> ThreadPolicyGeneration = 1;
+    std::atomic<uint32_t> LoggedThreadPolicyGeneration = 0;
+    bool Initialized = false;
+
+    struct Keyer {
+        NTV2Channel KeyChannel;
+        UWord Mixer;
+    };
+    // Fill channel to its key frame store and mixer. Guarded by ChannelsMutex
+    std::unordered_map<NTV2Channel, Keyer> Keyers;
+
+    std::array<std::atomic_bool, NTV2_MAX_NUM_CHANNELS> AncInsertEnabled{};
+
+    std::mutex AudioMutex;
+    std::array<std::shared_ptr<AudioStream>, NTV2_MAX_NUM_CHANNELS> AudioStreams;
+
+    std::mutex OutputQueuesMutex;
+    std::array<std::shared_ptr<OutputQueue>, NTV2_MAX_NUM_CHANNELS> OutputQueues;
+
+    std::array<nos::aja::BufferingController, NTV2_MAX_NUM_CHANNELS> BufferingControllers;
+
+    struct InputSignalWatch {
+        NTV2Channel Channel;
+        uint32_t StableFrames;
+        InputSignalListener Listener;
+    };
+    struct {
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::unordered_map<uint32_t, InputSignalWatch> Watches;
+        uint32_t NextID = 1;
+        uint32_t CallingID = 0; // Listener being called without the lock, removing it waits for the call
+        bool Stop = false;
+        std::thread Thread; // Started with the first listener
+    } InputSignalMonitor;
+
+    std::mutex BypassMutex;
+    // Output channel to the crosspoint its SDI output was connected to before bypass was engaged
+    std::unordered_map<NTV2Channel, NTV2OutputCrosspointID> BypassRestore;
 };
 
 inline NTV2Channel ParseChannel(std::string_view const &name)
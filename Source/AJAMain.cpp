@@ -32,6 +32,16 @@ enum class Nodes : int
 	DMARead,
 	WaitVBL,
 	Channel,
+	BatchDMA,
+	Bypass,
+	Recorder,
+	ClipPlayout,
+	BurnIn,
+	AudioRead,
+	AudioWrite,
+	OutputBuffering,
+	FrameSyncWrite,
+	FrameSyncRead,
 	Count
 };
 
@@ -39,6 +49,16 @@ nosResult RegisterDMAWriteNode(nosNodeFunctions*);
 nosResult RegisterDMAReadNode(nosNodeFunctions*);
 nosResult RegisterWaitVBLNode(nosNodeFunctions*);
 nosResult RegisterChannelNode(nosNodeFunctions*);
+nosResult RegisterBatchDMANode(nosNodeFunctions*);
+nosResult RegisterBypassNode(nosNodeFunctions*);
+nosResult RegisterRecorderNode(nosNodeFunctions*);
+nosResult RegisterClipPlayoutNode(nosNodeFunctions*);
+nosResult RegisterBurnInNode(nosNodeFunctions*);
+nosResult RegisterAudioReadNode(nosNodeFunctions*);
+nosResult RegisterAudioWriteNode(nosNodeFunctions*);
+nosResult RegisterOutputBufferingNode(nosNodeFunctions*);
+nosResult RegisterFrameSyncWriteNode(nosNodeFunctions*);
+nosResult RegisterFrameSyncReadNode(nosNodeFunctions*);
 
 struct AJAPluginFunctions : nos::PluginFunctions
 {
@@ -48,12 +68,20 @@ struct AJAPluginFunctions : nos::PluginFunctions
 		if (!outList)
 			return NOS_RESULT_SUCCESS;
 
-		AJADevice::AvailableDevices = AJADevice::EnumerateDevices();
-
 		NOS_RETURN_ON_FAILURE(RegisterDMAWriteNode(outList[(int)Nodes::DMAWrite]))
 		NOS_RETURN_ON_FAILURE(RegisterWaitVBLNode(outList[(int)Nodes::WaitVBL]))
 		NOS_RETURN_ON_FAILURE(RegisterChannelNode(outList[(int)Nodes::Channel]))
 		NOS_RETURN_ON_FAILURE(RegisterDMAReadNode(outList[(int)Nodes::DMARead]))
+		NOS_RETURN_ON_FAILURE(RegisterBatchDMANode(outList[(int)Nodes::BatchDMA]))
+		NOS_RETURN_ON_FAILURE(RegisterBypassNode(outList[(int)Nodes::Bypass]))
+		NOS_RETURN_ON_FAILURE(RegisterRecorderNode(outList[(int)Nodes::Recorder]))
+		NOS_RETURN_ON_FAILURE(RegisterClipPlayoutNode(outList[(int)Nodes::ClipPlayout]))
+		NOS_RETURN_ON_FAILURE(RegisterBurnInNode(outList[(int)Nodes::BurnIn]))
+		NOS_RETURN_ON_FAILURE(RegisterAudioReadNode(outList[(int)Nodes::AudioRead]))
+		NOS_RETURN_ON_FAILURE(RegisterAudioWriteNode(outList[(int)Nodes::AudioWrite]))
+		NOS_RETURN_ON_FAILURE(RegisterOutputBufferingNode(outList[(int)Nodes::OutputBuffering]))
+		NOS_RETURN_ON_FAILURE(RegisterFrameSyncWriteNode(outList[(int)Nodes::FrameSyncWrite]))
+		NOS_RETURN_ON_FAILURE(RegisterFrameSyncReadNode(outList[(int)Nodes::FrameSyncRead]))
 		return NOS_RESULT_SUCCESS;
 	}
 
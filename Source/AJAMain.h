@@ -39,9 +39,8 @@ extern nos::Name NSN_AJA_AJAOut;
 
 namespace nos::aja
 {
-inline nosVec2u GetDeltaSeconds(NTV2VideoFormat format, bool interlaced)
+inline nosVec2u GetDeltaSeconds(NTV2FrameRate frameRate)
 {
-	NTV2FrameRate frameRate = GetNTV2FrameRateFromVideoFormat(format);
 	nosVec2u deltaSeconds = { 1,50 };
 	switch (frameRate)
 	{
@@ -61,6 +60,12 @@ inline nosVec2u GetDeltaSeconds(NTV2VideoFormat format, bool interlaced)
 	case NTV2_FRAMERATE_1498:	deltaSeconds = { 1001, 15000 }; break;
 	default:					deltaSeconds = { 1, 50 }; break;
 	}
+	return deltaSeconds;
+}
+
+inline nosVec2u GetDeltaSeconds(NTV2VideoFormat format, bool interlaced)
+{
+	nosVec2u deltaSeconds = GetDeltaSeconds(GetNTV2FrameRateFromVideoFormat(format));
 	if (interlaced)
 		deltaSeconds.y = deltaSeconds.y * 2;
 	return deltaSeconds;
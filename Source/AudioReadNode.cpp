@@ -0,0 +1,126 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+
+namespace nos::aja
+{
+
+// Hands out the embedded audio of an input, one block per Wait VBL. Blocks are captured by the device's audio thread
+// at the same interrupt that wakes Wait VBL, so each frame gets exactly the samples that arrived with it.
+struct AudioReadNodeContext : NodeContext
+{
+	AudioReadNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	~AudioReadNodeContext() override
+	{
+		CloseStream();
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
+		uint32_t curVBLCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CurrentVBL")].Data);
+		uint32_t audioChannels = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("AudioChannels")].Data);
+		uint32_t ringDepth = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("RingDepth")].Data);
+
+		if (!channelInfo->device() || !channelInfo->channel_name() || !channelInfo->is_input())
+			return NOS_RESULT_FAILED;
+		if (!OpenStream(channelInfo, audioChannels, ringDepth))
+			return NOS_RESULT_FAILED;
+
+		TAudioBlock out{};
+		out.vbl_count = curVBLCount;
+		out.sample_rate = AJADevice::AudioSampleRate;
+		out.channel_count = Stream->Ring.GetChannelCount();
+		{
+			ScopedProfilerEvent _("AJA Audio Read");
+			// The audio thread may still be transferring the block of this VBL, it signals once it is done with it
+			{
+				std::unique_lock lock(Stream->HandledMutex);
+				Stream->Handled.wait_for(lock, std::chrono::milliseconds(4), [&] { return int32_t(Stream->HandledVBL - curVBLCount) >= 0 || Stream->Stop; });
+			}
+			bool first = true;
+			while (auto* block = Stream->Ring.Peek())
+			{
+				if (int32_t(block->VBLCount - curVBLCount) > 0)
+					break; // Belongs to the next frame
+				if (first)
+					out.sample_position = block->SamplePosition;
+				out.discontinuity |= block->Discontinuity || (!first && block->SamplePosition != out.sample_position + out.samples.size() / out.channel_count);
+				out.samples.insert(out.samples.end(), block->Samples.begin(), block->Samples.begin() + block->SampleCount * out.channel_count);
+				first = false;
+				Stream->Ring.Pop();
+			}
+			out.discontinuity |= !first && NextSamplePosition && out.sample_position != NextSamplePosition;
+			if (!first)
+				NextSamplePosition = out.sample_position + out.samples.size() / out.channel_count;
+		}
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Audio")].Id, Buffer::From(out));
+
+		uint32_t overruns = uint32_t(Stream->Overruns.load());
+		if (overruns != Overruns)
+		{
+			Overruns = overruns;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Overruns")].Id, Buffer::From(Overruns));
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	bool OpenStream(const ChannelInfo* channelInfo, uint32_t audioChannels, uint32_t ringDepth)
+	{
+		auto device = AJADevice::GetDeviceBySerialNumber(channelInfo->device()->serial_number());
+		auto channel = ParseChannel(channelInfo->channel_name()->string_view());
+		if (Stream && !Stream->Stop && Device == device && Stream->Channel == channel && AudioChannels == audioChannels && RingDepth == ringDepth)
+			return true;
+		CloseStream();
+		if (!device)
+			return false;
+		Stream = device->OpenAudio(channel, true, audioChannels, ringDepth);
+		if (!Stream)
+		{
+			SetNodeStatusMessages({fb::TNodeStatusMessage{{}, "Audio of the channel is unavailable or in use", fb::NodeStatusMessageType::FAILURE}});
+			return false;
+		}
+		Device = device;
+		AudioChannels = audioChannels;
+		RingDepth = ringDepth;
+		NextSamplePosition = 0;
+		SetNodeStatusMessages({fb::TNodeStatusMessage{{}, std::to_string(Stream->Ring.GetChannelCount()) + " channels, 48 kHz", fb::NodeStatusMessageType::INFO}});
+		return true;
+	}
+
+	void CloseStream()
+	{
+		if (Device && Stream)
+			Device->CloseAudio(Stream);
+		Stream = nullptr;
+		Device = nullptr;
+	}
+
+	void OnPathStop() override
+	{
+		CloseStream();
+	}
+
+	std::shared_ptr<AJADevice> Device;
+	std::shared_ptr<AJADevice::AudioStream> Stream;
+	uint32_t AudioChannels = 0;
+	uint32_t RingDepth = 0;
+	uint64_t NextSamplePosition = 0;
+	uint32_t Overruns = 0;
+};
+
+nosResult RegisterAudioReadNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.AudioRead"), AudioReadNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
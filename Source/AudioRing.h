@@ -0,0 +1,66 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace nos::aja
+{
+// Blocks of interleaved 32-bit audio samples passed between the audio thread of a channel and its node.
+// Single producer, single consumer; neither side blocks or allocates once the ring is created.
+class AudioRing
+{
+public:
+	struct Block
+	{
+		uint32_t VBLCount = 0;
+		uint64_t SamplePosition = 0; // First sample frame of the block since the audio system was started
+		uint32_t SampleCount = 0; // Sample frames in the block
+		bool Discontinuity = false; // Samples were lost right before this block
+		std::vector<int32_t> Samples; // SampleCount * channel count used, sized for MaxSamples
+	};
+
+	AudioRing(uint32_t depth, uint32_t channelCount, uint32_t maxSamples)
+		: Blocks(depth), ChannelCount(channelCount), MaxSamples(maxSamples)
+	{
+		for (auto& block : Blocks)
+			block.Samples.resize(size_t(maxSamples) * channelCount);
+	}
+	AudioRing(AudioRing const&) = delete;
+	AudioRing& operator=(AudioRing const&) = delete;
+
+	uint32_t GetChannelCount() const { return ChannelCount; }
+	uint32_t GetMaxSamples() const { return MaxSamples; }
+
+	// Producer. Returns nullptr if the ring is full.
+	Block* BeginWrite()
+	{
+		uint64_t tail = Tail.load(std::memory_order_relaxed);
+		if (tail - Head.load(std::memory_order_acquire) == Blocks.size())
+			return nullptr;
+		return &Blocks[tail % Blocks.size()];
+	}
+	void EndWrite() { Tail.fetch_add(1, std::memory_order_release); }
+
+	// Consumer. Returns nullptr if the ring is empty.
+	Block* Peek()
+	{
+		uint64_t head = Head.load(std::memory_order_relaxed);
+		if (head == Tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &Blocks[head % Blocks.size()];
+	}
+	void Pop() { Head.fetch_add(1, std::memory_order_release); }
+
+	size_t Size() const { return size_t(Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_acquire)); }
+
+private:
+	std::vector<Block> Blocks;
+	uint32_t ChannelCount;
+	uint32_t MaxSamples;
+	alignas(64) std::atomic<uint64_t> Head = 0;
+	alignas(64) std::atomic<uint64_t> Tail = 0;
+};
+} // namespace nos::aja
@@ -0,0 +1,147 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+
+namespace nos::aja
+{
+
+// Queues audio blocks for embedding into an output. The device's audio thread keeps the card's audio buffer a fixed
+// distance ahead of the play head at each output VBL, so the audio keeps a constant offset to the frames of the channel.
+struct AudioWriteNodeContext : NodeContext
+{
+	AudioWriteNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	~AudioWriteNodeContext() override
+	{
+		CloseStream();
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
+		auto& audioData = *execParams[NOS_NAME_STATIC("Audio")].Data;
+		uint32_t audioChannels = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("AudioChannels")].Data);
+		uint32_t ringDepth = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("RingDepth")].Data);
+
+		if (!channelInfo->device() || !channelInfo->channel_name() || channelInfo->is_input())
+			return NOS_RESULT_FAILED;
+		if (!OpenStream(channelInfo, audioChannels, ringDepth))
+			return NOS_RESULT_FAILED;
+
+		if (audioData.Size)
+		{
+			ScopedProfilerEvent _("AJA Audio Write");
+			auto* audio = InterpretPinValue<AudioBlock>(audioData);
+			if (audio->samples() && audio->channel_count())
+				Push(audio->samples()->data(), audio->samples()->size() / audio->channel_count(), audio->channel_count());
+		}
+
+		uint32_t underruns = uint32_t(Stream->Underruns.load());
+		if (underruns != Underruns)
+		{
+			Underruns = underruns;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Underruns")].Id, Buffer::From(Underruns));
+		}
+		if (DroppedSamples != ReportedDroppedSamples)
+		{
+			ReportedDroppedSamples = DroppedSamples;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("DroppedSamples")].Id, Buffer::From(ReportedDroppedSamples));
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	// Splits the samples into ring blocks, dropping or zero filling channels the output doesn't have
+	void Push(const int32_t* samples, uint32_t sampleCount, uint32_t channelCount)
+	{
+		auto& ring = Stream->Ring;
+		const uint32_t ringChannels = ring.GetChannelCount();
+		while (sampleCount)
+		{
+			auto* block = ring.BeginWrite();
+			if (!block)
+			{
+				// Ring is full, reported through the Dropped Samples pin
+				DroppedSamples += sampleCount;
+				return;
+			}
+			const uint32_t count = std::min(sampleCount, ring.GetMaxSamples());
+			if (channelCount == ringChannels)
+			{
+				std::copy_n(samples, size_t(count) * channelCount, block->Samples.data());
+			}
+			else
+			{
+				const uint32_t copied = std::min(channelCount, ringChannels);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					int32_t* dst = block->Samples.data() + size_t(i) * ringChannels;
+					std::copy_n(samples + size_t(i) * channelCount, copied, dst);
+					std::fill(dst + copied, dst + ringChannels, 0);
+				}
+			}
+			block->SampleCount = count;
+			ring.EndWrite();
+			samples += size_t(count) * channelCount;
+			sampleCount -= count;
+		}
+	}
+
+	bool OpenStream(const ChannelInfo* channelInfo, uint32_t audioChannels, uint32_t ringDepth)
+	{
+		auto device = AJADevice::GetDeviceBySerialNumber(channelInfo->device()->serial_number());
+		auto channel = ParseChannel(channelInfo->channel_name()->string_view());
+		if (Stream && !Stream->Stop && Device == device && Stream->Channel == channel && AudioChannels == audioChannels && RingDepth == ringDepth)
+			return true;
+		CloseStream();
+		if (!device)
+			return false;
+		Stream = device->OpenAudio(channel, false, audioChannels, ringDepth);
+		if (!Stream)
+		{
+			SetNodeStatusMessages({fb::TNodeStatusMessage{{}, "Audio of the channel is unavailable or in use", fb::NodeStatusMessageType::FAILURE}});
+			return false;
+		}
+		Device = device;
+		AudioChannels = audioChannels;
+		RingDepth = ringDepth;
+		DroppedSamples = 0;
+		SetNodeStatusMessages({fb::TNodeStatusMessage{{}, std::to_string(Stream->Ring.GetChannelCount()) + " channels, 48 kHz", fb::NodeStatusMessageType::INFO}});
+		return true;
+	}
+
+	void CloseStream()
+	{
+		if (Device && Stream)
+			Device->CloseAudio(Stream);
+		Stream = nullptr;
+		Device = nullptr;
+	}
+
+	void OnPathStop() override
+	{
+		CloseStream();
+	}
+
+	std::shared_ptr<AJADevice> Device;
+	std::shared_ptr<AJADevice::AudioStream> Stream;
+	uint32_t AudioChannels = 0;
+	uint32_t RingDepth = 0;
+	uint32_t Underruns = 0;
+	uint32_t DroppedSamples = 0; // Samples that didn't fit into the ring since the stream was opened
+	uint32_t ReportedDroppedSamples = 0;
+};
+
+nosResult RegisterAudioWriteNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.AudioWrite"), AudioWriteNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
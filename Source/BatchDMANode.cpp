@@ -0,0 +1,268 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosVulkanSubsystem/Helpers.hpp>
+#include <nosUtil/Stopwatch.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+#include "DMANodeBase.hpp"
+
+namespace nos::aja
+{
+
+// Runs the transfers given to one DMA engine of a device in order. Lives as long as the path runs so that no thread
+// is started per frame and the thread policy of the device is applied once.
+class DMAEngineWorker
+{
+public:
+	DMAEngineWorker(std::shared_ptr<AJADevice> device, NTV2DMAEngine engine)
+		: Device(std::move(device)), Name("Batch DMA " + std::to_string(engine - NTV2_DMA1 + 1)), Thread([this] { Run(); })
+	{
+	}
+	~DMAEngineWorker()
+	{
+		{
+			std::unique_lock lock(Mutex);
+			Stop = true;
+		}
+		Wake.notify_one();
+		Thread.join();
+	}
+
+	void Post(std::function<void()> job)
+	{
+		{
+			std::unique_lock lock(Mutex);
+			Jobs.push_back(std::move(job));
+		}
+		Wake.notify_one();
+	}
+
+	void WaitIdle()
+	{
+		std::unique_lock lock(Mutex);
+		Idle.wait(lock, [this] { return Jobs.empty() && !Busy; });
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock lock(Mutex);
+		while (true)
+		{
+			Wake.wait(lock, [this] { return Stop || !Jobs.empty(); });
+			if (Jobs.empty())
+				return;
+			auto job = std::move(Jobs.front());
+			Jobs.pop_front();
+			Busy = true;
+			lock.unlock();
+			Device->ApplyThreadPolicy(AppliedPolicy, Name);
+			job();
+			lock.lock();
+			Busy = false;
+			if (Jobs.empty())
+				Idle.notify_all();
+		}
+	}
+
+	std::shared_ptr<AJADevice> Device;
+	std::string Name;
+	AppliedThreadPolicy AppliedPolicy;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Idle;
+	std::deque<std::function<void()>> Jobs;
+	bool Busy = false;
+	bool Stop = false;
+	std::thread Thread; // Last, starts once the rest is constructed
+};
+
+// Transfers frames of several channels of a device in one execution, in a deterministic order:
+// writes first since they must land before the next flip, then reads. Within a direction, channels
+// with the shortest frame period go first, ties are broken by channel index.
+struct BatchDMANodeContext : NodeContext
+{
+	BatchDMANodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	struct Entry : DMAChannel
+	{
+		Entry(DMADirection dir) : DMAChannel(dir) { DeferWatchLogs = true; }
+		// Reported on the graph thread once the batch is done
+		bool Dropped = false;
+		void OnDMADrop() override
+		{
+			Dropped = true;
+		}
+	};
+
+	struct Request
+	{
+		size_t Index;
+		Entry* Channel;
+		nosResourceShareInfo Buffer;
+		u8* Data;
+		uint64_t FramePeriodNs;
+		bool Transferred = false;
+	};
+
+	std::map<std::tuple<uint64_t, std::string, bool>, std::unique_ptr<Entry>> Entries;
+	std::map<std::pair<AJADevice*, NTV2DMAEngine>, std::unique_ptr<DMAEngineWorker>> Workers;
+
+	DMAEngineWorker& GetWorker(std::shared_ptr<AJADevice> const& device, NTV2DMAEngine engine)
+	{
+		auto& worker = Workers[{device.get(), engine}];
+		if (!worker)
+			worker = std::make_unique<DMAEngineWorker>(device, engine);
+		return *worker;
+	}
+
+	Entry* GetEntry(const ChannelInfo* channelInfo)
+	{
+		auto key = std::make_tuple(channelInfo->device()->serial_number(), channelInfo->channel_name()->str(), channelInfo->is_input());
+		auto& entry = Entries[key];
+		if (!entry)
+			entry = std::make_unique<Entry>(channelInfo->is_input() ? DMA_READ : DMA_WRITE);
+		return entry.get();
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto* channels = InterpretPinValue<flatbuffers::Vector<flatbuffers::Offset<ChannelInfo>>>(*execParams[NOS_NAME_STATIC("Channels")].Data);
+		auto* buffers = InterpretPinValue<flatbuffers::Vector<flatbuffers::Offset<sys::vulkan::Buffer>>>(*execParams[NOS_NAME_STATIC("Buffers")].Data);
+		auto fieldType = *InterpretPinValue<sys::vulkan::FieldType>(*execParams[NOS_NAME_STATIC("FieldType")].Data);
+		auto transferMode = *InterpretPinValue<InterlacedTransferMode>(*execParams[NOS_NAME_STATIC("TransferMode")].Data);
+		bool parallel = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Parallel")].Data);
+
+		if (!channels || !buffers || channels->size() != buffers->size())
+		{
+			nosEngine.LogE("Batch DMA: Channels and Buffers must have the same number of elements.");
+			return NOS_RESULT_FAILED;
+		}
+
+		std::vector<Request> requests;
+		requests.reserve(channels->size());
+		for (uint32_t i = 0; i < channels->size(); ++i)
+		{
+			auto* channelInfo = channels->Get(i);
+			if (!channelInfo->device() || !channelInfo->channel_name())
+				return NOS_RESULT_FAILED;
+			auto* entry = GetEntry(channelInfo);
+			if (!entry->SetChannelInfo(channelInfo) || entry->Format == NTV2_FORMAT_UNKNOWN)
+			{
+				nosEngine.LogE("Batch DMA: Channel %s is not valid.", channelInfo->channel_name()->c_str());
+				return NOS_RESULT_FAILED;
+			}
+			entry->SetTransferMode(transferMode);
+			auto buffer = vkss::ConvertToResourceInfo(*buffers->Get(i));
+			if (!buffer.Memory.Handle || buffer.Info.Buffer.Size != entry->GetDMAInfo().BufferSize)
+			{
+				nosEngine.LogE("Batch DMA: Buffer for %s is not valid.", entry->ChannelName.c_str());
+				return NOS_RESULT_FAILED;
+			}
+			auto deltaSeconds = GetDeltaSeconds(entry->Format, entry->IsFieldTransfer());
+			requests.push_back({.Index = i,
+								.Channel = entry,
+								.Buffer = buffer,
+								.Data = nosVulkan->Map(&buffer),
+								.FramePeriodNs = uint64_t(deltaSeconds.x) * 1'000'000'000ull / deltaSeconds.y});
+		}
+
+		std::stable_sort(requests.begin(), requests.end(), [](Request const& a, Request const& b) {
+			return std::make_tuple(a.Channel->IsInput(), a.FramePeriodNs, a.Channel->Channel) <
+				   std::make_tuple(b.Channel->IsInput(), b.FramePeriodNs, b.Channel->Channel);
+		});
+
+		// The VBL count is read right before the transfer, earlier transfers of the batch would otherwise count as drops
+		auto transfer = [fieldType](Request& request) {
+			auto* entry = request.Channel;
+			ULWord vblCount = 0;
+			entry->IsInput() ? entry->Device->GetInputVerticalInterruptCount(vblCount, entry->Channel)
+							 : entry->Device->GetOutputVerticalInterruptCount(vblCount, entry->Channel);
+			request.Transferred = entry->DMATransfer(fieldType, vblCount, request.Data, request.Buffer.Memory.Size);
+		};
+
+		{
+			ScopedProfilerEvent _("AJA Batch DMA");
+			if (parallel && requests.size() > 1)
+			{
+				// Spread the transfers over the DMA engines of each device, in the sorted order
+				std::unordered_map<AJADevice*, uint32_t> nextEngine;
+				std::vector<DMAEngineWorker*> used;
+				for (auto& request : requests)
+				{
+					auto* device = request.Channel->Device.get();
+					uint32_t engineCount = std::max(1u, uint32_t(NTV2DeviceGetNumDMAEngines(device->ID)));
+					request.Channel->DMAEngine = NTV2DMAEngine(NTV2_DMA1 + (nextEngine[device]++ % engineCount));
+					auto& worker = GetWorker(request.Channel->Device, request.Channel->DMAEngine);
+					worker.Post([&transfer, &request] { transfer(request); });
+					used.push_back(&worker);
+				}
+				for (auto* worker : used)
+					worker->WaitIdle();
+			}
+			else
+			{
+				for (auto& request : requests)
+				{
+					request.Channel->DMAEngine = NTV2_DMA_FIRST_AVAILABLE;
+					transfer(request);
+				}
+			}
+		}
+
+		for (auto& request : requests)
+		{
+			request.Channel->FlushWatchLogs();
+			if (std::exchange(request.Channel->Dropped, false))
+				nosEngine.CallNodeFunction(NodeId, NOS_NAME("Drop"));
+		}
+
+		std::sort(requests.begin(), requests.end(), [](Request const& a, Request const& b) { return a.Index < b.Index; });
+		flatbuffers::FlatBufferBuilder fbb;
+		std::vector<flatbuffers::Offset<sys::vulkan::Buffer>> outputs;
+		for (auto& request : requests)
+		{
+			if (request.Channel->IsInput())
+				request.Buffer.Info.Buffer.FieldType = (nosTextureFieldType)(request.Channel->IsFieldTransfer() ? fieldType : sys::vulkan::FieldType::PROGRESSIVE);
+			auto buffer = vkss::ConvertBufferInfo(request.Buffer);
+			outputs.push_back(sys::vulkan::CreateBuffer(fbb, &buffer));
+		}
+		fbb.Finish(fbb.CreateVector(outputs));
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Outputs")].Id, nosBuffer{.Data = fbb.GetBufferPointer(), .Size = fbb.GetSize()});
+		return NOS_RESULT_SUCCESS;
+	}
+
+	void OnPathStart() override
+	{
+		for (auto& [_, entry] : Entries)
+			entry->ResetTransferState();
+	}
+
+	void OnPathStop() override
+	{
+		Workers.clear();
+		Entries.clear();
+	}
+};
+
+nosResult RegisterBatchDMANode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.BatchDMA"), BatchDMANodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
@@ -0,0 +1,97 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "BufferingController.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace nos::aja
+{
+static std::string FormatFrames(float frames)
+{
+	char text[32];
+	std::snprintf(text, sizeof(text), "%.2f", frames);
+	return text;
+}
+
+void BufferingController::Configure(Settings settings)
+{
+	settings.MaxDepth = std::max(settings.MaxDepth, 1u);
+	settings.MinDepth = std::clamp(settings.MinDepth, 1u, settings.MaxDepth);
+	settings.StableFrames = std::max(settings.StableFrames, 1u);
+	std::unique_lock lock(Mutex);
+	if (Configured && settings == Current)
+		return;
+	const bool wasAdaptive = Configured && Current.Adaptive;
+	Current = settings;
+	Configured = true;
+	Waits.clear();
+	Waits.reserve(settings.StableFrames);
+	if (!settings.Adaptive)
+		SetDepth(settings.MaxDepth, "Fixed at " + std::to_string(settings.MaxDepth) + " frames");
+	else if (!wasAdaptive)
+		SetDepth(settings.MaxDepth, "Started at the latency ceiling of " + std::to_string(settings.MaxDepth) + " frames");
+	else if (Depth < settings.MinDepth || Depth > settings.MaxDepth)
+		SetDepth(std::clamp(Depth, settings.MinDepth, settings.MaxDepth), "Limits changed to " + std::to_string(settings.MinDepth) + "-" + std::to_string(settings.MaxDepth) + " frames");
+}
+
+void BufferingController::AddFrame(float waitFrames, bool dropped)
+{
+	std::unique_lock lock(Mutex);
+	if (!Current.Adaptive)
+		return;
+	if (Holdoff)
+	{
+		--Holdoff;
+		return;
+	}
+	Waits.push_back(std::max(waitFrames, 0.f));
+	if (dropped)
+	{
+		const std::string wait = FormatFrames(GetWaitPercentile(0.99f));
+		if (Depth < Current.MaxDepth)
+			SetDepth(Depth + 1, "Grew to " + std::to_string(Depth + 1) + " frames after a drop, p99 wait " + wait + " frames");
+		else
+			SetDepth(Depth, "Dropped at the latency ceiling of " + std::to_string(Depth) + " frames, p99 wait " + wait + " frames");
+		return;
+	}
+	if (Waits.size() < Current.StableFrames)
+		return;
+	const float p99 = GetWaitPercentile(0.99f);
+	const std::string stable = std::to_string(Waits.size()) + " frames without drops, p99 wait " + FormatFrames(p99) + " frames";
+	if (Depth > Current.MinDepth && p99 <= Current.ShrinkWaitFrames)
+		SetDepth(Depth - 1, "Shrank to " + std::to_string(Depth - 1) + " frames after " + stable);
+	else
+		SetDepth(Depth, "Kept " + std::to_string(Depth) + " frames after " + stable);
+}
+
+uint32_t BufferingController::GetDepth()
+{
+	std::unique_lock lock(Mutex);
+	return Depth;
+}
+
+std::string BufferingController::GetReason()
+{
+	std::unique_lock lock(Mutex);
+	return Reason;
+}
+
+void BufferingController::SetDepth(uint32_t depth, std::string reason)
+{
+	Depth = depth;
+	Reason = std::move(reason);
+	Waits.clear();
+	// A deeper ring takes that many frames to fill, a shallower one as long to show whether it holds
+	Holdoff = depth;
+}
+
+float BufferingController::GetWaitPercentile(float p)
+{
+	if (Waits.empty())
+		return 0;
+	auto nth = Waits.begin() + size_t(p * float(Waits.size() - 1));
+	std::nth_element(Waits.begin(), nth, Waits.end());
+	return *nth;
+}
+} // namespace nos::aja
@@ -0,0 +1,48 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nos::aja
+{
+// Depth of the buffer ring in front of an output. Grows after drops and shrinks back after a stable period in which
+// the output hardly ever had to wait for the renderer after its VBL, so the output runs at the lowest latency that
+// stays drop free on the machine.
+class BufferingController
+{
+public:
+	struct Settings
+	{
+		bool Adaptive = false; // Otherwise the depth stays at MaxDepth
+		uint32_t MinDepth = 1;
+		uint32_t MaxDepth = 2; // Latency ceiling
+		uint32_t StableFrames = 1800; // Frames without drops before the depth is lowered
+		float ShrinkWaitFrames = 0.1f; // Longest 99th percentile wait of a stable period that still lowers the depth
+		bool operator==(Settings const&) const = default;
+	};
+	void Configure(Settings settings);
+
+	// waitFrames: how long after its VBL the output got the frame, in frames. dropped: the frame missed its VBL.
+	void AddFrame(float waitFrames, bool dropped);
+
+	uint32_t GetDepth();
+	// Why the depth is what it is, changes with every decision
+	std::string GetReason();
+
+private:
+	void SetDepth(uint32_t depth, std::string reason);
+	float GetWaitPercentile(float p);
+
+	std::mutex Mutex;
+	Settings Current;
+	bool Configured = false;
+	uint32_t Depth = 2;
+	std::string Reason;
+	uint32_t Holdoff = 0; // Frames the ring gets to fill up after a change, drops in them are not held against it
+	std::vector<float> Waits; // Of the current stable period
+};
+} // namespace nos::aja
@@ -0,0 +1,260 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "BurnIn.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace nos::aja
+{
+namespace
+{
+constexpr uint32_t GlyphWidth = 5;
+constexpr uint32_t GlyphHeight = 7;
+constexpr uint32_t CellWidth = GlyphWidth + 1;
+constexpr char FirstGlyph = ' ';
+constexpr char LastGlyph = '_';
+
+// 5x7 glyphs from ' ' to '_', one byte per row, bit 4 is the leftmost pixel
+constexpr uint8_t Font[LastGlyph - FirstGlyph + 1][GlyphHeight] = {
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+	{0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+	{0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00}, // '"'
+	{0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // '#'
+	{0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // '$'
+	{0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+	{0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // '&'
+	{0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}, // '''
+	{0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+	{0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+	{0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // '*'
+	{0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+	{0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ','
+	{0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+	{0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+	{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+	{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+	{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+	{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+	{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+	{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+	{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+	{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+	{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+	{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ';'
+	{0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // '<'
+	{0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+	{0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // '?'
+	{0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // '@'
+	{0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'A'
+	{0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // 'B'
+	{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // 'C'
+	{0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // 'D'
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // 'E'
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // 'F'
+	{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // 'G'
+	{0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'H'
+	{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'I'
+	{0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // 'J'
+	{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+	{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // 'L'
+	{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+	{0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+	{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'O'
+	{0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // 'P'
+	{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // 'Q'
+	{0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // 'R'
+	{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // 'S'
+	{0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'U'
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'V'
+	{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // 'W'
+	{0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // 'X'
+	{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // 'Y'
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // 'Z'
+	{0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // '['
+	{0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // '\'
+	{0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ']'
+	{0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // '^'
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // '_'
+};
+
+const uint8_t* GetGlyph(char c)
+{
+	if (c >= 'a' && c <= 'z')
+		c = char(c - 'a' + 'A');
+	if (c < FirstGlyph || c > LastGlyph)
+		c = '?';
+	return Font[c - FirstGlyph];
+}
+
+// Both formats pack a whole number of pixels into 16 bytes: 8 pixels of 2vuy, 6 pixels of v210. A group is drawn by
+// one 16 byte masked store: dst = (dst & ~Mask) | Value, looked up by the bits of its pixels.
+struct Group
+{
+	uint64_t Value[2];
+	uint64_t Mask[2];
+};
+
+constexpr uint32_t GroupPixels(bool tenBit)
+{
+	return tenBit ? 6 : 8;
+}
+
+constexpr uint32_t Y8Text = 235, Y8Box = 16, C8 = 128;
+constexpr uint32_t Y10Text = 940, Y10Box = 64, C10 = 512;
+
+Group MakeGroup2vuy(uint32_t bits, bool background)
+{
+	uint8_t value[16] = {}, mask[16] = {};
+	for (uint32_t pair = 0; pair < 4; ++pair)
+	{
+		bool left = bits & (1u << (pair * 2));
+		bool right = bits & (1u << (pair * 2 + 1));
+		uint8_t* v = value + pair * 4;
+		uint8_t* m = mask + pair * 4;
+		// U Y0 V Y1, chroma of the pair is neutral under text
+		if (background || left || right)
+		{
+			v[0] = v[2] = C8;
+			m[0] = m[2] = 0xFF;
+		}
+		if (background || left)
+		{
+			v[1] = left ? Y8Text : Y8Box;
+			m[1] = 0xFF;
+		}
+		if (background || right)
+		{
+			v[3] = right ? Y8Text : Y8Box;
+			m[3] = 0xFF;
+		}
+	}
+	Group group;
+	memcpy(group.Value, value, 16);
+	memcpy(group.Mask, mask, 16);
+	return group;
+}
+
+Group MakeGroupV210(uint32_t bits, bool background)
+{
+	// Samples in the order they are packed, three 10-bit samples per 32-bit word
+	struct Sample
+	{
+		bool Luma;
+		uint32_t Pixel;
+	};
+	constexpr Sample Samples[12] = {{false, 0}, {true, 0}, {false, 0}, {true, 1}, {false, 2}, {true, 2},
+									{false, 2}, {true, 3}, {false, 4}, {true, 4}, {false, 4}, {true, 5}};
+	uint32_t value[4] = {}, mask[4] = {};
+	for (uint32_t i = 0; i < 12; ++i)
+	{
+		auto [luma, pixel] = Samples[i];
+		bool on = luma ? bool(bits & (1u << pixel)) : bool(bits & (3u << pixel));
+		if (!background && !on)
+			continue;
+		uint32_t sample = luma ? (on ? Y10Text : Y10Box) : C10;
+		value[i / 3] |= sample << (10 * (i % 3));
+		mask[i / 3] |= 0x3FFu << (10 * (i % 3));
+	}
+	Group group;
+	memcpy(group.Value, value, 16);
+	memcpy(group.Mask, mask, 16);
+	return group;
+}
+
+// Lookup tables indexed by [tenBit][background], built once
+std::vector<Group> const& GetGroups(bool tenBit, bool background)
+{
+	static const auto tables = [] {
+		std::array<std::array<std::vector<Group>, 2>, 2> re;
+		for (int tenBit = 0; tenBit < 2; ++tenBit)
+			for (int background = 0; background < 2; ++background)
+			{
+				auto& table = re[tenBit][background];
+				table.resize(size_t(1) << GroupPixels(tenBit));
+				for (uint32_t bits = 0; bits < table.size(); ++bits)
+					table[bits] = tenBit ? MakeGroupV210(bits, background) : MakeGroup2vuy(bits, background);
+			}
+		return re;
+	}();
+	return tables[tenBit][background];
+}
+} // namespace
+
+size_t GetBurnInPitch(uint32_t width, bool tenBit)
+{
+	// Same as DMAChannel::GetDMAInfo: v210 lines are padded to 48 pixels
+	return tenBit ? size_t((width + (48 - width % 48) % 48) / 3) * 8 : size_t(width) * 2;
+}
+
+void BurnInText(BurnInTarget const& target, std::string_view text, uint32_t x, uint32_t y, uint32_t scaleX, uint32_t scaleY, bool background)
+{
+	if (!target.Data || text.empty() || !scaleX || !scaleY)
+		return;
+	const uint32_t groupPixels = GroupPixels(target.TenBit);
+	auto const& groups = GetGroups(target.TenBit, background);
+
+	// Box around the text: one font pixel of padding on each side
+	const uint32_t boxX = x / groupPixels;
+	const uint32_t textWidth = (uint32_t(text.size()) * CellWidth + 1) * scaleX;
+	const uint32_t maxGroups = uint32_t(target.Pitch / 16);
+	if (boxX >= maxGroups || y >= target.Height)
+		return;
+	const uint32_t groupCount = std::min((textWidth + groupPixels - 1) / groupPixels, maxGroups - boxX);
+	const uint32_t rows = GlyphHeight + 2;
+
+	// Each row of the font is expanded into groups once, then stored into scaleY lines
+	std::vector<uint8_t> pixels(size_t(groupCount) * groupPixels);
+	std::vector<Group const*> line(groupCount);
+	for (uint32_t row = 0; row < rows; ++row)
+	{
+		std::fill(pixels.begin(), pixels.end(), 0);
+		if (row > 0 && row <= GlyphHeight)
+		{
+			for (size_t c = 0; c < text.size(); ++c)
+			{
+				uint8_t bits = GetGlyph(text[c])[row - 1];
+				for (uint32_t col = 0; col < GlyphWidth; ++col)
+				{
+					if (!(bits & (0x10 >> col)))
+						continue;
+					size_t begin = ((c * CellWidth) + 1 + col) * scaleX;
+					size_t end = std::min(begin + scaleX, pixels.size());
+					if (begin < end)
+						std::fill(pixels.begin() + begin, pixels.begin() + end, 1);
+				}
+			}
+		}
+		for (uint32_t g = 0; g < groupCount; ++g)
+		{
+			uint32_t bits = 0;
+			for (uint32_t p = 0; p < groupPixels; ++p)
+				bits |= uint32_t(pixels[g * groupPixels + p]) << p;
+			line[g] = &groups[bits];
+		}
+
+		for (uint32_t repeat = 0; repeat < scaleY; ++repeat)
+		{
+			uint32_t lineIndex = y + row * scaleY + repeat;
+			if (lineIndex >= target.Height)
+				return;
+			uint8_t* dst = target.Data + lineIndex * target.Pitch + size_t(boxX) * 16;
+			for (uint32_t g = 0; g < groupCount; ++g, dst += 16)
+			{
+				uint64_t word[2];
+				memcpy(word, dst, 16);
+				word[0] = (word[0] & ~line[g]->Mask[0]) | line[g]->Value[0];
+				word[1] = (word[1] & ~line[g]->Mask[1]) | line[g]->Value[1];
+				memcpy(dst, word, 16);
+			}
+		}
+	}
+}
+} // namespace nos::aja
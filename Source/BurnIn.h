@@ -0,0 +1,28 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace nos::aja
+{
+// Frame in the layout DMA nodes use: 2vuy (8-bit) or v210 (10-bit)
+struct BurnInTarget
+{
+	uint8_t* Data;
+	uint32_t Width; // Pixels
+	uint32_t Height; // Lines in the buffer
+	size_t Pitch; // Bytes per line
+	bool TenBit;
+};
+
+// Bytes per line of a frame in the layout DMA nodes use
+size_t GetBurnInPitch(uint32_t width, bool tenBit);
+
+// Draws a line of text in a 5x7 font, each font pixel scaled to scaleX x scaleY pixels. x is rounded down to the packing
+// of the format. Lowercase letters are drawn as uppercase, characters without a glyph are drawn as '?'.
+// The text is drawn white, over a black box if background is set.
+void BurnInText(BurnInTarget const& target, std::string_view text, uint32_t x, uint32_t y, uint32_t scaleX, uint32_t scaleY, bool background);
+} // namespace nos::aja
@@ -0,0 +1,127 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosVulkanSubsystem/Helpers.hpp>
+#include <nosUtil/Stopwatch.hpp>
+
+#include <cstring>
+
+#include "AJA_generated.h"
+#include "AJAMain.h"
+#include "BurnIn.h"
+
+namespace nos::aja
+{
+
+// Burns timecode, channel name and VBL count into a frame on the host, right before DMA Write, so that confidence
+// monitoring doesn't need a text pass on the GPU. The input can be shared with other consumers, the text is drawn
+// into a copy owned by the node.
+struct BurnInNodeContext : NodeContext
+{
+	BurnInNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	~BurnInNodeContext() override
+	{
+		if (Copy.Memory.Handle)
+			nosVulkan->DestroyResource(&Copy);
+	}
+
+	// Host visible buffer like the input, recreated when the input's size changes
+	nosResourceShareInfo Copy{};
+
+	bool UpdateCopy(nosResourceShareInfo const& input)
+	{
+		if (Copy.Memory.Handle && Copy.Info.Buffer.Size == input.Info.Buffer.Size && Copy.Info.Buffer.Usage == input.Info.Buffer.Usage)
+			return true;
+		if (Copy.Memory.Handle)
+			nosVulkan->DestroyResource(&Copy);
+		Copy = {};
+		Copy.Info = input.Info;
+		if (nosVulkan->CreateResource(&Copy) != NOS_RESULT_SUCCESS)
+		{
+			Copy = {};
+			nosEngine.LogE("Burn In: Unable to create the output buffer.");
+			return false;
+		}
+		return true;
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto input = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*execParams[NOS_NAME_STATIC("Input")].Data));
+		auto* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
+		std::string timecode = InterpretPinValue<const char>(*execParams[NOS_NAME_STATIC("Timecode")].Data);
+		bool showChannel = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("ShowChannel")].Data);
+		bool showVBL = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("ShowVBL")].Data);
+		uint32_t curVBLCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CurrentVBL")].Data);
+		auto position = *InterpretPinValue<fb::vec2>(*execParams[NOS_NAME_STATIC("Position")].Data);
+		uint32_t scale = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("Scale")].Data);
+		bool background = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Background")].Data);
+
+		if (!input.Memory.Handle || !channelInfo->resolution())
+			return NOS_RESULT_FAILED;
+
+		std::string text = timecode;
+		auto append = [&text](std::string const& part) {
+			if (!text.empty())
+				text += "  ";
+			text += part;
+		};
+		if (showChannel && channelInfo->channel_name())
+			append(channelInfo->channel_name()->str());
+		if (showVBL)
+			append("VBL " + std::to_string(curVBLCount));
+
+		// Nothing to draw, the input goes out as is
+		if (text.empty())
+		{
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Output")].Id, Buffer::From(vkss::ConvertBufferInfo(input)));
+			return NOS_RESULT_SUCCESS;
+		}
+
+		bool tenBit = channelInfo->frame_buffer_format() != mediaio::YCbCrPixelFormat::YUV8;
+		uint32_t width = channelInfo->resolution()->x();
+		size_t pitch = GetBurnInPitch(width, tenBit);
+		uint32_t height = uint32_t(input.Memory.Size / pitch);
+		if (!height)
+			return NOS_RESULT_FAILED;
+		// Buffers of single fields have half the lines, keep the text the same size on screen
+		bool isField = input.Info.Buffer.FieldType != (nosTextureFieldType)sys::vulkan::FieldType::PROGRESSIVE &&
+					   input.Info.Buffer.FieldType != (nosTextureFieldType)sys::vulkan::FieldType::UNKNOWN;
+		if (!scale)
+			scale = std::max(1u, channelInfo->resolution()->y() / 270);
+		uint32_t x = uint32_t(std::clamp(position.x(), 0.f, 1.f) * width);
+		uint32_t y = uint32_t(std::clamp(position.y(), 0.f, 1.f) * height);
+
+		if (!UpdateCopy(input))
+			return NOS_RESULT_FAILED;
+		Copy.Info.Buffer.FieldType = input.Info.Buffer.FieldType;
+
+		util::Stopwatch sw;
+		{
+			ScopedProfilerEvent _("AJA Burn In");
+			u8* data = nosVulkan->Map(&Copy);
+			memcpy(data, nosVulkan->Map(&input), std::min(Copy.Memory.Size, input.Memory.Size));
+			BurnInText({.Data = data, .Width = width, .Height = height, .Pitch = pitch, .TenBit = tenBit},
+					   text, x, y, scale, isField ? std::max(1u, scale / 2) : scale, background);
+		}
+		nosEngine.WatchLog("AJA Burn In", util::Stopwatch::ElapsedString(sw.Elapsed()).c_str());
+
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Output")].Id, Buffer::From(vkss::ConvertBufferInfo(Copy)));
+		return NOS_RESULT_SUCCESS;
+	}
+};
+
+nosResult RegisterBurnInNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.BurnIn"), BurnInNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
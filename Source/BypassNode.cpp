@@ -0,0 +1,128 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+#include <future>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+
+namespace nos::aja
+{
+
+struct BypassNodeContext : NodeContext
+{
+	BypassNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	~BypassNodeContext() override
+	{
+		if (Pending.valid())
+			Engaged = Pending.get() ? PendingEngage : Engaged;
+		if (Device && Engaged)
+			Device->SetBypass(InputChannel, OutputChannel, IsQuad, false);
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* execParams) override
+	{
+		NodeExecuteParams params = execParams;
+		auto* inputInfo = InterpretPinValue<ChannelInfo>(*params[NOS_NAME_STATIC("Input")].Data);
+		auto* outputInfo = InterpretPinValue<ChannelInfo>(*params[NOS_NAME_STATIC("Output")].Data);
+		bool engage = *InterpretPinValue<bool>(*params[NOS_NAME_STATIC("Engage")].Data);
+		bool syncToVBL = *InterpretPinValue<bool>(*params[NOS_NAME_STATIC("SyncToVBL")].Data);
+
+		if (!inputInfo->device() || !outputInfo->device() || !inputInfo->channel_name() || !outputInfo->channel_name())
+			return NOS_RESULT_FAILED;
+		if (inputInfo->device()->serial_number() != outputInfo->device()->serial_number())
+		{
+			nosEngine.LogE("Bypass: Input and output have to be on the same device.");
+			return NOS_RESULT_FAILED;
+		}
+		if (inputInfo->is_quad() != outputInfo->is_quad())
+		{
+			nosEngine.LogE("Bypass: Input and output have to be both single link or both quad link.");
+			return NOS_RESULT_FAILED;
+		}
+		auto device = AJADevice::GetDeviceBySerialNumber(outputInfo->device()->serial_number());
+		if (!device)
+			return NOS_RESULT_FAILED;
+		auto inputChannel = ParseChannel(inputInfo->channel_name()->string_view());
+		auto outputChannel = ParseChannel(outputInfo->channel_name()->string_view());
+
+		// A switch waiting for the VBL is reported once it is done, nothing else changes until then
+		if (Pending.valid())
+		{
+			if (Pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return NOS_RESULT_SUCCESS;
+			if (!Pending.get())
+			{
+				nosEngine.LogE("Bypass: Unable to %s bypass from %s to %s.", PendingEngage ? "engage" : "release", inputInfo->channel_name()->c_str(), outputInfo->channel_name()->c_str());
+				return NOS_RESULT_FAILED;
+			}
+			SetEngaged(params, PendingEngage);
+		}
+
+		// The output was re-routed or closed, which drops the bypass on the device
+		if (Engaged && !Device->IsBypassed(OutputChannel))
+			SetEngaged(params, false);
+
+		// Routing changed while engaged, release the old bypass first
+		if (Engaged && (device != Device || inputChannel != InputChannel || outputChannel != OutputChannel))
+		{
+			Device->SetBypass(InputChannel, OutputChannel, IsQuad, false);
+			Engaged = false;
+		}
+		Device = device;
+		InputChannel = inputChannel;
+		OutputChannel = outputChannel;
+		IsQuad = outputInfo->is_quad();
+
+		if (engage != Engaged)
+		{
+			if (engage && inputInfo->video_format_idx() != outputInfo->video_format_idx())
+				nosEngine.LogW("Bypass: Input format %s does not match output format %s.", inputInfo->video_format()->c_str(), outputInfo->video_format()->c_str());
+			// Switch right after the output VBL so that the change takes effect on a frame boundary. The wait runs off the
+			// graph thread, the result is picked up by a later execution.
+			if (syncToVBL)
+			{
+				PendingEngage = engage;
+				Pending = std::async(std::launch::async, [device = Device, in = InputChannel, out = OutputChannel, quad = IsQuad, engage] {
+					device->WaitForOutputVerticalInterrupt(out);
+					return device->SetBypass(in, out, quad, engage);
+				});
+				return NOS_RESULT_SUCCESS;
+			}
+			if (!Device->SetBypass(InputChannel, OutputChannel, IsQuad, engage))
+			{
+				nosEngine.LogE("Bypass: Unable to %s bypass from %s to %s.", engage ? "engage" : "release", inputInfo->channel_name()->c_str(), outputInfo->channel_name()->c_str());
+				return NOS_RESULT_FAILED;
+			}
+			SetEngaged(params, engage);
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	void SetEngaged(NodeExecuteParams& params, bool engaged)
+	{
+		Engaged = engaged;
+		nosEngine.SetPinValue(params[NOS_NAME_STATIC("Engaged")].Id, nos::Buffer::From(Engaged));
+	}
+
+	std::shared_ptr<AJADevice> Device;
+	NTV2Channel InputChannel = NTV2_CHANNEL_INVALID;
+	NTV2Channel OutputChannel = NTV2_CHANNEL_INVALID;
+	bool IsQuad = false;
+	bool Engaged = false;
+	std::future<bool> Pending;
+	bool PendingEngage = false;
+};
+
+nosResult RegisterBypassNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.Bypass"), BypassNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
@@ -0,0 +1,59 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <numeric>
+
+namespace nos::aja
+{
+// Spreads frames rendered at one rate over the VBLs of an output running at another, e.g. 50 fps on a 59.94 Hz output.
+// Each rendered frame stays on air for a whole number of VBLs: 1 most of the time, 2 for the frames repeated when the
+// output is faster, 0 for the frames skipped when it is slower. The count is kept Bresenham style, so the VBLs given
+// to the first n frames never differ from n times the rate ratio by more than half a VBL and the pattern repeats
+// exactly, e.g. 5 frames over 6 VBLs for 50 fps on 60 Hz.
+class CadenceScheduler
+{
+public:
+	// Frame periods in seconds as numerator and denominator, see GetDeltaSeconds. Starts over when the ratio changes.
+	void Configure(uint32_t renderNum, uint32_t renderDen, uint32_t outputNum, uint32_t outputDen)
+	{
+		// VBLs per rendered frame: (renderNum / renderDen) / (outputNum / outputDen)
+		uint64_t step = uint64_t(renderNum) * outputDen;
+		uint64_t modulus = uint64_t(renderDen) * outputNum;
+		if (!step || !modulus)
+			step = modulus = 1;
+		const uint64_t divisor = std::gcd(step, modulus);
+		step /= divisor;
+		modulus /= divisor;
+		if (step == Step && modulus == Modulus)
+			return;
+		Step = step;
+		Modulus = modulus;
+		Reset();
+	}
+
+	void Reset() { Error = Modulus / 2; }
+
+	// Render and output run at the same rate
+	bool IsIdentity() const { return Step == Modulus; }
+
+	// VBLs the next rendered frame is shown for
+	uint32_t Next()
+	{
+		Error += Step;
+		const uint32_t vbls = uint32_t(Error / Modulus);
+		Error %= Modulus;
+		return vbls;
+	}
+
+	// Rendered frames and VBLs of one period of the pattern
+	uint64_t GetPatternFrames() const { return Modulus; }
+	uint64_t GetPatternVBLs() const { return Step; }
+
+private:
+	uint64_t Step = 1;
+	uint64_t Modulus = 1;
+	uint64_t Error = 0;
+};
+} // namespace nos::aja
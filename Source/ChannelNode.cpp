@@ -19,6 +19,14 @@ NOS_REGISTER_NAME(QuadLinkOutputMode);
 NOS_REGISTER_NAME(IsOpen);
 NOS_REGISTER_NAME(FrameBufferFormat);
 NOS_REGISTER_NAME(ForceInterlaced);
+NOS_REGISTER_NAME(KeyerBackgroundInput);
+NOS_REGISTER_NAME(SeparateSquares);
+NOS_REGISTER_NAME(RealTimeThreads);
+NOS_REGISTER_NAME(ThreadPriority);
+NOS_REGISTER_NAME(PinThreadsToCard);
+NOS_REGISTER_NAME(ExcludedCPUs);
+NOS_REGISTER_NAME(CrossRate);
+NOS_REGISTER_NAME(SignalStableFrames);
 
 enum class AJAChangedPinType
 {
@@ -44,6 +52,9 @@ struct ChannelNodeContext : NodeContext
 				auto name = pin->name()->c_str();
 				if (0 == strcmp(name, "Channel"))
 					CurrentChannel.ChannelPinId = *pin->id();
+				// Boards of the nodes being loaded open in parallel, the Device pin waits for its own
+				else if (0 == strcmp(name, "Device") && pin->data() && pin->data()->size())
+					AJADevice::OpenAsync((const char*)pin->data()->data());
 			}
 		}
 
@@ -86,12 +97,16 @@ struct ChannelNodeContext : NodeContext
 			{
 				if (oldDevice)
 				{
+					StopSignalMonitor();
 					oldDevice->UnregisterNode(NodeId);
 					oldDevice->RemoveReferenceSourceListener(RefListenerId);
 				}
 				if(Device)
 				{
 					Device->RegisterNode(NodeId);
+					UpdateThreadPolicy(false);
+					if (CrossRate)
+						Device->SetCrossRateOutputs(true);
 					RefListenerId = Device->AddReferenceSourceListener([this](NTV2ReferenceSource ref) {
 						auto refStr = NTV2ReferenceSourceToString(ref, true);
 						SetPinValue(NSN_ReferenceSource, nosBuffer{ .Data = (void*)refStr.c_str(), .Size = refStr.size() + 1 });
@@ -193,10 +208,45 @@ struct ChannelNodeContext : NodeContext
 			ForceInterlaced = *InterpretPinValue<bool>(newVal);
 			TryUpdateChannel();
 		});
+		AddPinValueWatcher(NSN_KeyerBackgroundInput, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			KeyerBackgroundInput = *InterpretPinValue<uint32_t>(newVal);
+			TryUpdateChannel();
+		});
+		AddPinValueWatcher(NSN_SeparateSquares, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			SeparateSquares = *InterpretPinValue<bool>(newVal);
+			TryUpdateChannel();
+		});
+		AddPinValueWatcher(NSN_RealTimeThreads, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			ThreadPolicy.RealTime = *InterpretPinValue<bool>(newVal);
+			UpdateThreadPolicy(oldValue.has_value());
+		});
+		AddPinValueWatcher(NSN_ThreadPriority, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			ThreadPolicy.Priority = *InterpretPinValue<uint32_t>(newVal);
+			UpdateThreadPolicy(oldValue.has_value());
+		});
+		AddPinValueWatcher(NSN_PinThreadsToCard, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			ThreadPolicy.PinToCardNode = *InterpretPinValue<bool>(newVal);
+			UpdateThreadPolicy(oldValue.has_value());
+		});
+		AddPinValueWatcher(NSN_ExcludedCPUs, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			ThreadPolicy.ExcludedCpus = ParseCpuList(InterpretPinValue<const char>(newVal));
+			UpdateThreadPolicy(oldValue.has_value());
+		});
+		AddPinValueWatcher(NSN_CrossRate, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			CrossRate = *InterpretPinValue<bool>(newVal);
+			// Like the thread settings, shared by the Channel nodes of the device
+			if (Device && (oldValue.has_value() || CrossRate))
+				Device->SetCrossRateOutputs(CrossRate);
+		});
+		AddPinValueWatcher(NSN_SignalStableFrames, [this](const nos::Buffer& newVal, std::optional<nos::Buffer> oldValue) {
+			SignalStableFrames = *InterpretPinValue<uint32_t>(newVal);
+			UpdateSignalMonitor();
+		});
 	}
 
 	~ChannelNodeContext() override
 	{
+		StopSignalMonitor();
 		if (Device)
 		{
 			Device->UnregisterNode(NodeId);
@@ -207,6 +257,15 @@ struct ChannelNodeContext : NodeContext
 	}
 	
 	mediaio::YCbCrPixelFormat CurrentPixelFormat = mediaio::YCbCrPixelFormat::YUV8;
+	bool CrossRate = false;
+
+	// Thread settings belong to the device, so the Channel nodes of a device share them. A node hands over its settings
+	// when they are edited, or when it is loaded with settings other than the defaults.
+	void UpdateThreadPolicy(bool edited)
+	{
+		if (Device && (edited || ThreadPolicy != aja::ThreadPolicy{}))
+			Device->SetThreadPolicy(ThreadPolicy);
+	}
 
 	void UpdateReferenceSource()
 	{
@@ -244,6 +303,7 @@ struct ChannelNodeContext : NodeContext
 	void TryUpdateChannel() 
 	{ 
 		CurrentChannel.Update({}, true);
+		UpdateSignalMonitor();
 		if (!ShouldOpen)
 			return;
 		auto format = GetVideoFormat();
@@ -275,6 +335,8 @@ struct ChannelNodeContext : NodeContext
 		}
 		channelPin.frame_buffer_format = static_cast<mediaio::YCbCrPixelFormat>(CurrentPixelFormat);
 		channelPin.is_interlaced = !IsProgressivePicture(format);
+		channelPin.keyer_background_input = IsInput ? 0 : KeyerBackgroundInput;
+		channelPin.separate_squares = !IsSingleLink && SeparateSquares;
  		CurrentChannel.Update(std::move(channelPin), true);
 		UpdateReferenceSource();
 	}
@@ -333,17 +395,65 @@ struct ChannelNodeContext : NodeContext
 	{
 		if (!Device || !IsInput)
 			return;
+		std::optional<AJADevice::InputSignalChange> change;
+		{
+			std::unique_lock lock(SignalMutex);
+			change = std::exchange(PendingSignalChange, std::nullopt);
+		}
+		// While the monitor watches the input only its settled changes count, a format read here may be a flap
+		if (SignalWatch.ListenerId && !change)
+			return;
+		if (change)
+			SignalLost = false;
 		if (CurrentChannel.IsOpen)
 		{
-			auto format = Device->GetSDIInputVideoFormat(Channel);
-			if (ForceInterlaced)
-				format = Device->ForceInterlace(format);
-			if (format == CurrentChannel.Info.video_format_idx)
+			if (GetInputSignalFormat() == CurrentChannel.Info.video_format_idx)
 				return;
 		}
 		TryUpdateChannel();
-		if(CurrentChannel.IsOpen)
-			nosEngine.LogI("Input signal reconnected.");
+		if (!change)
+		{
+			if (CurrentChannel.IsOpen)
+				nosEngine.LogI("Input signal reconnected.");
+			return;
+		}
+		const auto nowNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		const double recoveryMs = double(nowNs - change->ChangeStartNs) / 1e6;
+		const double settleMs = double(change->SettledNs - change->ChangeStartNs) / 1e6;
+		if (CurrentChannel.IsOpen)
+			nosEngine.LogI("AJA: Input %s settled at %s, recovered in %.1f ms (%.1f ms settling, %u flaps).", ChannelPinValue.c_str(),
+						   NTV2VideoFormatToString(change->Format, true).c_str(), recoveryMs, settleMs, change->Flaps);
+		else
+			nosEngine.LogW("AJA: Input %s lost its signal, closed in %.1f ms (%.1f ms settling, %u flaps).", ChannelPinValue.c_str(), recoveryMs, settleMs, change->Flaps);
+		nosEngine.WatchLog((ChannelPinValue + " Signal Recovery").c_str(), (std::to_string(uint64_t(recoveryMs)) + " ms").c_str());
+	}
+
+	// Inputs are watched by the device's signal monitor, whose settled changes are handled by CheckChannelStatus
+	void UpdateSignalMonitor()
+	{
+		const bool watch = Device && IsInput && ShouldOpen && Channel != NTV2_CHANNEL_INVALID;
+		if (watch && SignalWatch.ListenerId && SignalWatch.Device == Device && SignalWatch.Channel == Channel && SignalWatch.StableFrames == SignalStableFrames)
+			return;
+		StopSignalMonitor();
+		if (!watch)
+			return;
+		SignalWatch = {Device, Channel, SignalStableFrames, 0};
+		SignalWatch.ListenerId = Device->AddInputSignalListener(Channel, SignalStableFrames, [this](AJADevice::InputSignalChange const& change) {
+			{
+				std::unique_lock lock(SignalMutex);
+				PendingSignalChange = change;
+			}
+			nosEngine.CallNodeFunction(NodeId, NOS_NAME("CheckChannelStatus"));
+		});
+	}
+
+	void StopSignalMonitor()
+	{
+		if (SignalWatch.Device && SignalWatch.ListenerId)
+			SignalWatch.Device->RemoveInputSignalListener(SignalWatch.ListenerId);
+		SignalWatch = {};
+		std::unique_lock lock(SignalMutex);
+		PendingSignalChange = std::nullopt;
 	}
 
 	void UpdateVisualizer(nos::Name pinName, std::string stringListName)
@@ -480,7 +590,7 @@ struct ChannelNodeContext : NodeContext
 	std::vector<std::string> GetPossibleDeviceNames()
 	{
 		std::vector<std::string> devices = {"NONE"};
-		for (auto& [name, serial] : AJADevice::EnumerateDevices())
+		for (auto& [name, serial] : AJADevice::RefreshDevices())
 		{
 			devices.push_back(name);
 		}
@@ -603,19 +713,9 @@ struct ChannelNodeContext : NodeContext
 		{
 			if (!IsSingleLink)
 				if (Device->CanMakeQuadInputFromChannel(Channel))
-				{
-					auto fmt = Device->GetSDIInputVideoFormat(Channel);
-					if(ForceInterlaced)
-						return Device->ForceInterlace(fmt);
-					return fmt;
-				}
+					return GetInputSignalFormat();
 			if (Device->ChannelCanInput(Channel))
-			{
-				auto fmt = Device->GetSDIInputVideoFormat(Channel);
-				if(ForceInterlaced)
-					return Device->ForceInterlace(fmt);
-				return fmt;
-			}
+				return GetInputSignalFormat();
 			return NTV2_FORMAT_UNKNOWN;
 		}
 		for (int i = 0; i < NTV2_MAX_NUM_VIDEO_FORMATS; ++i)
@@ -630,6 +730,17 @@ struct ChannelNodeContext : NodeContext
 		return NTV2_FORMAT_UNKNOWN;
 	}
 
+	// Quad links of UHD make an 8K input, quad links of HD are scaled to UHD by GetExtent
+	NTV2VideoFormat GetInputSignalFormat()
+	{
+		auto fmt = Device->GetSDIInputVideoFormat(Channel);
+		if (!IsSingleLink)
+			fmt = AJADevice::GetQuadQuadFormat(fmt);
+		if (ForceInterlaced)
+			return Device->ForceInterlace(fmt);
+		return fmt;
+	}
+
 	std::pair<NTV2Channel, AJADevice::Mode> GetChannelFromString(const std::string& str)
 	{
 		for (u32 i = NTV2_CHANNEL1; i < NTV2_MAX_NUM_CHANNELS; ++i)
@@ -688,6 +799,13 @@ struct ChannelNodeContext : NodeContext
 			{
 				auto* context = static_cast<ChannelNodeContext*>(ctx);
 				context->TryFindChannel = true;
+				// A watched input is reopened once its signal settles, restarting on every failed VBL would cause a restart storm
+				if (context->SignalWatch.ListenerId)
+				{
+					if (!std::exchange(context->SignalLost, true))
+						nosEngine.LogW("Input signal lost, waiting for it to settle.");
+					return NOS_RESULT_SUCCESS;
+				}
 				nosEngine.SendPathRestart(context->NodeId);
 				nosEngine.LogW("Input signal lost.");
 				return NOS_RESULT_SUCCESS;
@@ -726,6 +844,20 @@ struct ChannelNodeContext : NodeContext
 	bool ShouldOpen = false;
 	bool IsInput = false;
 	bool ForceInterlaced = false;
+	uint32_t KeyerBackgroundInput = 0;
+	bool SeparateSquares = false;
+	uint32_t SignalStableFrames = 5;
+	struct
+	{
+		AJADevice* Device = nullptr;
+		NTV2Channel Channel = NTV2_CHANNEL_INVALID;
+		uint32_t StableFrames = 0;
+		uint32_t ListenerId = 0;
+	} SignalWatch;
+	std::mutex SignalMutex;
+	std::optional<AJADevice::InputSignalChange> PendingSignalChange; // Set by the monitor thread
+	bool SignalLost = false;
+	aja::ThreadPolicy ThreadPolicy;
 	std::string DevicePinValue = "NONE";
 	std::string ChannelPinValue = "NONE";
 	std::string ResolutionPinValue = "NONE";
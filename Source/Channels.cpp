@@ -32,11 +32,18 @@ AJADevice::Mode Channel::GetMode() const
 	return static_cast<AJADevice::Mode>(Info.output_quad_link_mode);
 }
 
+NTV2Channel Channel::GetKeyerBackground() const
+{
+	if (Info.is_input || !Info.keyer_background_input)
+		return NTV2_CHANNEL_INVALID;
+	return NTV2Channel(Info.keyer_background_input - 1);
+}
+
 bool Channel::Open()
 {
 	DropCount = 0;
 	ClearStatus(StatusType::DropCount);
-	auto device = GetDevice();
+	auto device = Info.device ? AJADevice::OpenDevice(Info.device->serial_number) : nullptr;
 	auto channel = GetChannel();
 	if (!device || channel == NTV2_CHANNEL_INVALID)
 	{
@@ -67,7 +74,9 @@ bool Channel::Open()
 	                        GetMode(),
 	                        Info.frame_buffer_format == mediaio::YCbCrPixelFormat::YUV8
 		                        ? NTV2_FBF_8BIT_YCBCR
-		                        : NTV2_FBF_10BIT_YCBCR))
+		                        : NTV2_FBF_10BIT_YCBCR,
+	                        GetKeyerBackground(),
+	                        Info.separate_squares))
 	{
 		device->SetRegisterWriteMode(
 			IsProgressivePicture(fmt) ? NTV2_REGWRITE_SYNCTOFRAME : NTV2_REGWRITE_SYNCTOFIELD,
@@ -87,6 +96,9 @@ bool Channel::Open()
 			
 			ch += ' ' + NTV2VideoFormatToString(fmt, true);
 
+			if (auto background = GetKeyerBackground(); NTV2_IS_VALID_CHANNEL(background))
+				ch += " over SDI In " + std::to_string(background + 1);
+
 			if (Info.is_quad && !NTV2_IS_QUAD_FRAME_FORMAT(fmt))
 			{
 				ch.replace(ch.find("1080p"), 5, "UHDp");
@@ -227,7 +239,8 @@ auto EnumerateFormats()
 
 void EnumerateOutputChannels(flatbuffers::FlatBufferBuilder& fbb, std::vector<flatbuffers::Offset<nos::ContextMenuItem>>& devices)
 {
-	for (auto& [serial, device] : AJADevice::Devices)
+	// Boards are listed once open, building the menus does not open them
+	for (auto& device : AJADevice::GetOpenDevices())
 	{
 		std::vector<flatbuffers::Offset<nos::ContextMenuItem>> channels;
 		static auto Descriptors = EnumerateFormats();
@@ -293,7 +306,7 @@ void EnumerateOutputChannels(flatbuffers::FlatBufferBuilder& fbb, std::vector<fl
 
 void EnumerateInputChannels(flatbuffers::FlatBufferBuilder& fbb, std::vector<flatbuffers::Offset<nos::ContextMenuItem>>& devices)
 {
-	for (auto& [serial, device] : AJADevice::Devices)
+	for (auto& device : AJADevice::GetOpenDevices())
 	{
 		std::vector<flatbuffers::Offset<nos::ContextMenuItem>> channels;
 		static auto Descriptors = EnumerateFormats();
@@ -48,6 +48,8 @@ struct Channel
 
 	AJADevice::Mode GetMode() const;
 
+	NTV2Channel GetKeyerBackground() const;
+
 	bool Open();
 
 	void Close();
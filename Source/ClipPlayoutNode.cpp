@@ -0,0 +1,171 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosUtil/Stopwatch.hpp>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+#include "DMANodeBase.hpp"
+#include "RawClip.h"
+
+namespace nos::aja
+{
+
+// Plays a raw clip out of a channel. The clip is memory mapped and frames are transferred straight from the mapped
+// pages, so there is no copy or upload on the way. Frames ahead of the playhead are prefetched from storage.
+struct ClipPlayoutNodeContext : DMANodeBase
+{
+	ClipPlayoutNodeContext(const nosFbNode* node) : DMANodeBase(node, DMA_WRITE)
+	{
+	}
+
+	std::unique_ptr<RawClipReader> Clip;
+	nos::Buffer LastChannelInfo = {};
+
+	// Playhead is derived from the VBL count, so a late execution never shifts the clip in time
+	bool Started = false;
+	uint32_t StartVBL = 0;
+	uint32_t LastCueVBL = 0;
+	uint32_t LastFrame = UINT32_MAX;
+
+	void OnPinValueChanged(nos::Name pinName, nosUUID pinId, nosBuffer value) override
+	{
+		if (pinName == NOS_NAME_STATIC("Channel"))
+		{
+			if (LastChannelInfo.Size() == value.Size && memcmp(LastChannelInfo.Data(), value.Data, value.Size) == 0)
+				return;
+			LastChannelInfo = {};
+			Device = nullptr;
+			if (!SetChannelInfo(InterpretPinValue<ChannelInfo>(value)))
+			{
+				Device = nullptr;
+				return;
+			}
+			LastChannelInfo = value;
+			ResetTransferState();
+		}
+		else if (pinName == NOS_NAME_STATIC("TransferMode"))
+			SetTransferMode(*InterpretPinValue<InterlacedTransferMode>(value));
+		else if (pinName == NOS_NAME_STATIC("Path"))
+			OpenClip(InterpretPinValue<const char>(value));
+	}
+
+	void OpenClip(std::string const& path)
+	{
+		Clip.reset();
+		Started = false;
+		if (path.empty())
+		{
+			SetNodeStatusMessages({});
+			return;
+		}
+		auto clip = std::make_unique<RawClipReader>(path);
+		if (!clip->IsOpen())
+		{
+			nosEngine.LogE("Clip Playout: %s is not a valid raw clip.", path.c_str());
+			SetStatus(fb::NodeStatusMessageType::FAILURE, "Invalid clip");
+			return;
+		}
+		Clip = std::move(clip);
+		auto& header = Clip->GetHeader();
+		SetStatus(fb::NodeStatusMessageType::INFO, std::to_string(header.Width) + "x" + std::to_string(header.Height) + ", " + std::to_string(Clip->GetFrameCount()) + " frames");
+	}
+
+	void SetStatus(fb::NodeStatusMessageType type, std::string text)
+	{
+		SetNodeStatusMessages({fb::TNodeStatusMessage{{}, std::move(text), type}});
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto fieldType = *InterpretPinValue<sys::vulkan::FieldType>(*execParams[NOS_NAME_STATIC("FieldType")].Data);
+		uint32_t curVBLCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CurrentVBL")].Data);
+		bool play = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Play")].Data);
+		bool loop = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Loop")].Data);
+		uint32_t inPoint = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("InPoint")].Data);
+		uint32_t outPoint = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("OutPoint")].Data);
+		uint32_t cueVBL = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CueVBL")].Data);
+		uint32_t prefetch = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("Prefetch")].Data);
+
+		if (!Clip || !Device || Format == NTV2_FORMAT_UNKNOWN)
+			return NOS_RESULT_FAILED;
+
+		auto& header = Clip->GetHeader();
+		if (header.FrameSize != GetDMAInfo().BufferSize || bool(header.FieldTransfer) != IsFieldTransfer())
+		{
+			nosEngine.LogE("Clip Playout: Clip does not match the format or transfer mode of %s.", ChannelName.c_str());
+			return NOS_RESULT_FAILED;
+		}
+
+		uint32_t frameCount = uint32_t(std::min<uint64_t>(Clip->GetFrameCount(), UINT32_MAX));
+		outPoint = outPoint ? std::min(outPoint, frameCount) : frameCount;
+		if (inPoint >= outPoint)
+		{
+			nosEngine.LogE("Clip Playout: In point %u is not before out point %u.", inPoint, outPoint);
+			return NOS_RESULT_FAILED;
+		}
+
+		if (curVBLCount == 0)
+			Device->GetOutputVerticalInterruptCount(curVBLCount, Channel);
+
+		if (!play || cueVBL != LastCueVBL)
+			Started = false;
+		LastCueVBL = cueVBL;
+		if (play && !Started)
+		{
+			// A frame transferred in VBL N goes on air at N + 1, so the in point is transferred one VBL before the cue
+			StartVBL = cueVBL ? cueVBL - 1 : curVBLCount;
+			Started = true;
+		}
+
+		uint32_t frame = inPoint;
+		if (play && curVBLCount > StartVBL)
+		{
+			uint32_t elapsed = curVBLCount - StartVBL;
+			// VBLs of interlaced channels are fields, whole frames are transferred every other one
+			if (IsInterlaced() && !IsFieldTransfer())
+				elapsed >>= 1;
+			uint32_t length = outPoint - inPoint;
+			frame = loop ? inPoint + elapsed % length : inPoint + std::min(elapsed, length - 1);
+		}
+		else if (!play && LastFrame != UINT32_MAX)
+			frame = std::clamp(LastFrame, inPoint, outPoint - 1);
+
+		Clip->Prefetch(frame + 1, prefetch, inPoint);
+
+		if (frame != LastFrame || NeedsFrameSet || IsFieldTransfer())
+		{
+			// Mapped frames are page aligned, the driver locks the pages for the transfer
+			auto* data = const_cast<uint8_t*>(Clip->GetFrame(frame));
+			if (!DMATransfer(fieldType, curVBLCount, data, header.FrameSize))
+				return NOS_RESULT_SUCCESS;
+		}
+
+		if (frame != LastFrame)
+		{
+			LastFrame = frame;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Frame")].Id, Buffer::From(frame));
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	void OnPathStart() override
+	{
+		DMANodeBase::OnPathStart();
+		Started = false;
+		LastFrame = UINT32_MAX;
+	}
+};
+
+nosResult RegisterClipPlayoutNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.ClipPlayout"), ClipPlayoutNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
@@ -2,15 +2,18 @@
 
 #pragma once
 #include <Nodos/PluginHelpers.hpp>
+#include "DMASegments.h"
 
 namespace nos::aja
 {
     
-struct DMANodeBase : NodeContext
+// Frame store and transfer state of one channel. Used by DMA nodes, and on its own by nodes that transfer for several channels.
+struct DMAChannel
 {
-	DMANodeBase(const nosFbNode* node, DMADirection dir) : NodeContext(node), Direction(dir)
+	DMAChannel(DMADirection dir) : Direction(dir)
 	{
 	}
+	virtual ~DMAChannel() = default;
 
 	uint8_t DoubleBufferIdx = 0;
 	NTV2Channel Channel = NTV2_CHANNEL_INVALID;
@@ -20,12 +23,30 @@ struct DMANodeBase : NodeContext
 	AJADevice::Mode Mode = AJADevice::SL;
 	DMADirection Direction;
 	nos::mediaio::YCbCrPixelFormat PixelFormat = nos::mediaio::YCbCrPixelFormat::YUV8;
+	InterlacedTransferMode TransferMode = InterlacedTransferMode::PerField;
+	NTV2DMAEngine DMAEngine = NTV2_DMA_FIRST_AVAILABLE;
+	// Transfers run off the graph thread keep their watch logs here until FlushWatchLogs is called on it
+	bool DeferWatchLogs = false;
+	std::vector<std::pair<std::string, std::string>> DeferredWatchLogs;
+
+	void FlushWatchLogs()
+	{
+		for (auto& [label, value] : DeferredWatchLogs)
+			nosEngine.WatchLog(label.c_str(), value.c_str());
+		DeferredWatchLogs.clear();
+	}
 
 	bool IsInterlaced() const
 	{
 		return !IsProgressivePicture(Format);
 	}
 
+	// Interlaced signals in PerFrame mode are double buffered and transferred like progressive ones.
+	bool IsFieldTransfer() const
+	{
+		return IsInterlaced() && TransferMode == InterlacedTransferMode::PerField;
+	}
+
 	bool IsQuad() const
 	{
 		return AJADevice::IsQuad(Mode);
@@ -35,53 +56,197 @@ struct DMANodeBase : NodeContext
 		return Direction == DMA_READ;
 	}
 
+	// Frame store of the key when the output is keyed by the card's mixer
+	NTV2Channel KeyChannel = NTV2_CHANNEL_INVALID;
+
+	bool HasKey() const
+	{
+		return NTV2_IS_VALID_CHANNEL(KeyChannel);
+	}
+
+	// Squares mode without a quad frame store: each link's frame store holds its quadrant, see GetQuadrantSegments
+	bool SeparateSquares = false;
+
+	void UpdateFrameStores(const ChannelInfo* channelInfo)
+	{
+		KeyChannel = (!IsInput() && channelInfo->keyer_background_input()) ? AJADevice::GetKeyChannel(Channel, IsQuad()) : NTV2_CHANNEL_INVALID;
+		SeparateSquares = IsQuad() && Mode != AJADevice::TSI && channelInfo->separate_squares();
+	}
+
 	bool NeedsFrameSet = false;
 	ULWord NextVBL = 0;
 
-	virtual void OnPathStart() { NeedsFrameSet = true; DoubleBufferIdx = 0; NextVBL = 0; }
+	// Timecode and ANC packets of the frame being transferred, outputs only. Timecode is written with the frame flip.
+	NTV2_RP188 const* OutputTimecode = nullptr;
+	AJAAncillaryList* OutputAnc = nullptr;
+
+	// Result of the last transfer, for frame metadata
+	uint8_t LastFrameStore = 0;
+	bool LastDMADropped = false;
+
+	// Outputs only. A frame that cannot be transferred before its flip is not transferred, the card keeps showing the
+	// last completed frame store instead of a late transfer pushing every following frame back.
+	bool RepeatOnUnderrun = false;
+	bool HasCompletedFrame = false;
+	uint64_t RepeatedFrames = 0;
+	// Steady clock time the VBL of the frame was seen at, 0 if unknown. With it a late frame is seen before its deadline.
+	uint64_t VBLWakeupNs = 0;
+	// Slowest recent transfer of a frame, decays so that one slow transfer does not hold back the following frames
+	uint64_t ExpectedTransferNs = 0;
+
+	void ResetTransferState() { NeedsFrameSet = true; DoubleBufferIdx = 0; NextVBL = 0; HasCompletedFrame = false; }
+
+	virtual void OnDMADrop() {}
+	virtual void OnRepeat() {}
+
+	// True if the frame would miss the flip it is meant for, the frame is then skipped. Flips only follow completed
+	// transfers, so the card keeps showing the last completed frame store and nothing is written to it.
+	// Without VBLWakeupNs a late frame is only seen once its VBL has passed.
+	bool RepeatIfLate(uint32_t curVBLCount)
+	{
+		if (!RepeatOnUnderrun || IsInput() || IsFieldTransfer() || !HasCompletedFrame)
+			return false;
+		ULWord nowVBLCount = 0;
+		Device->GetOutputVerticalInterruptCount(nowVBLCount, Channel);
+		// Interlaced frames are flipped at frame boundaries, the VBL of the second field is still in time
+		if (nowVBLCount > curVBLCount + uint32_t(IsInterlaced()))
+			NextVBL = nowVBLCount; // The next frame can go out at the current VBL
+		else if (WillMissFlip())
+			NextVBL = nowVBLCount + 1; // The last frame is shown again at the next VBL
+		else
+			return false;
+		++RepeatedFrames;
+		OnRepeat();
+		return true;
+	}
+
+	// True if a transfer started now is expected to end after the next VBL
+	bool WillMissFlip() const
+	{
+		const nosVec2u period = GetDeltaSeconds(Format, false);
+		const uint64_t periodNs = 1'000'000'000ull * period.x / period.y;
+		// A transfer that never fits would skip every frame, it is sent late instead
+		if (!VBLWakeupNs || !ExpectedTransferNs || ExpectedTransferNs >= periodNs)
+			return false;
+		const auto nowNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		return nowNs + ExpectedTransferNs > VBLWakeupNs + periodNs;
+	}
+
+	bool SetChannelInfo(const ChannelInfo* channelInfo)
+	{
+		if (!channelInfo || !channelInfo->device() || !channelInfo->channel_name())
+			return false;
+		Device = AJADevice::GetDeviceBySerialNumber(channelInfo->device()->serial_number());
+		if (!Device)
+			return false;
+		ChannelName = channelInfo->channel_name()->str();
+		Channel = ParseChannel(ChannelName);
+		Format = NTV2VideoFormat(channelInfo->video_format_idx());
+		PixelFormat = channelInfo->frame_buffer_format();
+		if (channelInfo->is_quad())
+			Mode = IsInput() ? static_cast<AJADevice::Mode>(channelInfo->input_quad_link_mode())
+							 : static_cast<AJADevice::Mode>(channelInfo->output_quad_link_mode());
+		else
+			Mode = AJADevice::SL;
+		UpdateFrameStores(channelInfo);
+		return true;
+	}
+
+	// True if the mode changed
+	bool SetTransferMode(InterlacedTransferMode mode)
+	{
+		if (mode == TransferMode)
+			return false;
+		TransferMode = mode;
+		NeedsFrameSet = true;
+		return true;
+	}
+
+	bool TransferModeMismatch = false;
+
+	// Wait VBL decides how interlaced frames are waited for. With its metadata the DMA nodes follow that mode, their own
+	// pin is used only without it. A pin that disagrees is reported once.
+	bool UpdateTransferMode(InterlacedTransferMode pinMode, const FrameMetadata* vblMetadata)
+	{
+		const bool mismatch = vblMetadata && vblMetadata->transfer_mode() != pinMode && IsInterlaced();
+		if (mismatch && !TransferModeMismatch)
+			nosEngine.LogW("%s: Transfer Mode differs from the one of Wait VBL, %s is used.", ChannelName.c_str(),
+						   EnumNameInterlacedTransferMode(vblMetadata->transfer_mode()));
+		TransferModeMismatch = mismatch;
+		return SetTransferMode(vblMetadata ? vblMetadata->transfer_mode() : pinMode);
+	}
 
 	void SetFrame(u32 doubleBufferIndex)
 	{
-		u32 frameIndex = GetFrameBufferOffset(Channel, doubleBufferIndex) / Device->GetFBSize(Channel);
-		IsInput() ? Device->SetInputFrame(Channel, frameIndex)
-			: Device->SetOutputFrame(Channel, frameIndex);
+		SetFrame(Channel, doubleBufferIndex);
+		if (HasKey())
+			SetFrame(KeyChannel, doubleBufferIndex);
+	}
+
+	void SetFrame(NTV2Channel channel, u32 doubleBufferIndex)
+	{
+		u32 frameIndex = GetFrameBufferOffset(channel, doubleBufferIndex) / Device->GetFBSize(channel);
+		// Separate squares: the same store of each link, in the links' own parts of the card memory
+		const u32 linkFrameStep = SeparateSquares ? u32(GetMaxFrameBufferSize() * 2 / Device->GetFBSize(channel)) : 0;
+		if (!IsInput())
+		{
+			Device->WriteOutputFrameState(channel, IsQuad(), frameIndex, channel == Channel ? OutputTimecode : nullptr, linkFrameStep);
+			return;
+		}
+		Device->SetInputFrame(channel, frameIndex);
 		if (IsQuad())
-			for (u32 i = Channel + 1; i < Channel + 4u; ++i)
-				IsInput() ? Device->SetInputFrame(NTV2Channel(i), frameIndex)
-				: Device->SetOutputFrame(NTV2Channel(i), frameIndex);
+			for (u32 i = channel + 1; i < channel + 4u; ++i)
+				Device->SetInputFrame(NTV2Channel(i), frameIndex + (i - channel) * linkFrameStep);
 	}
 
 	uint32_t StartDoubleBuffer()
 	{
-		SetFrame(uint32_t(!IsInterlaced()));
+		if (IsInterlaced())
+			Device->SetRegisterWriteMode(IsFieldTransfer() ? NTV2_REGWRITE_SYNCTOFIELD : NTV2_REGWRITE_SYNCTOFRAME, Channel);
+		SetFrame(uint32_t(!IsFieldTransfer()));
 		return 0;
 	}
 
 	uint32_t NextDoubleBuffer(uint32_t curDoubleBuffer)
 	{
-		if (IsInterlaced())
+		if (IsFieldTransfer())
 			return curDoubleBuffer;
 		SetFrame(curDoubleBuffer);
 		return curDoubleBuffer ^ 1;
 	}
 
+	// Channels of the card, the memory layout below has a part for each
+	uint32_t GetChannelCount()
+	{
+		return std::clamp<uint32_t>(NTV2DeviceGetNumFrameStores(Device->ID), 1, NTV2_MAX_NUM_CHANNELS);
+	}
+
 	size_t GetMaxFrameBufferSize()
 	{
 		size_t max = 0;
 
-		for (int i = 0; i < NTV2_MAX_NUM_CHANNELS; ++i)
+		for (uint32_t i = 0; i < GetChannelCount(); ++i)
 			max = std::max(max, (size_t)Device->GetFBSize(NTV2Channel(i)));
 
 		return max;
 	}
 
-	std::unordered_map<NTV2Channel, std::unordered_map<uint8_t, size_t>> FrameBufferOffsets;
-
-	void OnPathStop() override
+	// Each channel has two frame stores in its own part of the card memory, sized for the largest frame store in use:
+	// 8K frame stores are 16 times the size of HD ones, so only the channels the card has get a part. Output queues
+	// use more, after the parts of all channels, as many as fit below the audio buffers and the 4 GiB a transfer can
+	// address.
+	uint32_t GetMaxFrameStores()
 	{
-		FrameBufferOffsets.clear();
+		const uint64_t maxSize = GetMaxFrameBufferSize();
+		const uint64_t queueStart = maxSize * 2 * GetChannelCount();
+		const uint64_t end = std::min<uint64_t>(Device->GetVideoMemorySize(), uint64_t(UINT32_MAX) + 1);
+		if (!maxSize || end <= queueStart)
+			return 2;
+		return 2 + uint32_t(std::min<uint64_t>((end - queueStart) / (maxSize * GetChannelCount()), 253));
 	}
 
+	std::unordered_map<NTV2Channel, std::unordered_map<uint8_t, size_t>> FrameBufferOffsets;
+
 	u32 GetFrameBufferOffset(NTV2Channel channel, uint8_t frame)
 	{
 		auto it = FrameBufferOffsets.find(channel);
@@ -89,7 +254,15 @@ struct DMANodeBase : NodeContext
 			it = FrameBufferOffsets.insert({ channel, {} }).first;
 		auto offsetIt = it->second.find(frame);
 		if (offsetIt == it->second.end())
-			offsetIt = it->second.insert({ frame, GetMaxFrameBufferSize() * 2 * channel + (uint32_t(frame) & 1) * Device->GetFBSize(channel) }).first;
+		{
+			const size_t maxSize = GetMaxFrameBufferSize();
+			size_t offset = 0;
+			if (frame < 2)
+				offset = maxSize * 2 * channel + frame * Device->GetFBSize(channel);
+			else
+				offset = maxSize * 2 * GetChannelCount() + (size_t(channel) * (GetMaxFrameStores() - 2) + frame - 2) * maxSize;
+			offsetIt = it->second.insert({ frame, offset }).first;
+		}
 		assert(offsetIt->second <= UINT32_MAX);
 		return u32(offsetIt->second);
 	}
@@ -104,18 +277,22 @@ struct DMANodeBase : NodeContext
 		u32 width, height;
 		Device->GetExtent(Format, Mode, width, height);
 		int BitWidth = PixelFormat == mediaio::YCbCrPixelFormat::YUV8 ? 8 : 10;
-		nosVec2u compressedExt((10 == BitWidth) ? ((width + (48 - width % 48) % 48) / 3) << 1 : width >> 1, height >> u32(IsInterlaced()));
-		uint32_t bufferSize = compressedExt.x * compressedExt.y * 4;
+		nosVec2u compressedExt((10 == BitWidth) ? ((width + (48 - width % 48) % 48) / 3) << 1 : width >> 1, height >> u32(IsFieldTransfer()));
+		// An 8K 10-bit frame is ~88 MB, computed in 64 bits so that larger rasters fail the size checks instead of wrapping
+		size_t bufferSize = size_t(compressedExt.x) * compressedExt.y * 4;
 		return {compressedExt, bufferSize};
 	}
 
-	void DMATransfer(nos::sys::vulkan::FieldType fieldType, uint32_t curVBLCount, uint8_t* buffer, uint64_t inputBufferSize)
+	bool DMATransfer(nos::sys::vulkan::FieldType fieldType, uint32_t curVBLCount, uint8_t* buffer, uint64_t inputBufferSize, uint8_t* keyBuffer = nullptr)
 	{
 		auto [compressedExt, bufferSize] = GetDMAInfo();
 		assert(bufferSize <= UINT32_MAX);
 
 		if (bufferSize != inputBufferSize)
-			return nosEngine.LogE("DMATransfer buffer size mismatch");
+		{
+			nosEngine.LogE("DMATransfer buffer size mismatch");
+			return false;
+		}
 
 		if (NeedsFrameSet)
 		{
@@ -124,40 +301,33 @@ struct DMANodeBase : NodeContext
 		}
 
 		if (curVBLCount < NextVBL)
-			return;
+			return false;
+
+		if (RepeatIfLate(curVBLCount))
+			return false;
 		
-		auto offset =  GetFrameBufferOffset(Channel, DoubleBufferIdx);
+		const auto transferStart = std::chrono::steady_clock::now();
+		TransferFrameStore(Channel, "AJA " + ChannelName + (IsInput() ? " DMA Read" : " DMA Write"), fieldType, buffer, compressedExt, bufferSize);
+		// Key has the same layout as the fill, it goes to its own frame store next to the fill
+		if (HasKey() && keyBuffer)
+			TransferFrameStore(KeyChannel, "AJA " + ChannelName + " DMA Write Key", fieldType, keyBuffer, compressedExt, bufferSize);
+		const auto transferNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - transferStart).count());
+		ExpectedTransferNs = std::max(transferNs, ExpectedTransferNs - ExpectedTransferNs / 8);
+		if (!IsInput())
 		{
-			ScopedProfilerEvent _("AJA " + ChannelName + (IsInput() ? " DMA Read" : " DMA Write"));
-			if (IsInterlaced())
-			{
-				auto pitch = compressedExt.x * 4;
-				auto segments = compressedExt.y;
-				auto fieldId = fieldType == nos::sys::vulkan::FieldType::EVEN ? NTV2_FIELD0 : NTV2_FIELD1;
-				util::Stopwatch sw;
-				Device->DmaTransfer(NTV2_DMA_FIRST_AVAILABLE, IsInput(), 0,
-					const_cast<ULWord*>((u32*)buffer), // target CPU buffer address
-					offset + fieldId * pitch, // source AJA buffer address
-					pitch, // length of one line
-					segments, // number of lines
-					pitch, // increment target buffer one line on CPU memory
-					pitch * 2, // increment AJA card source buffer double the size of one line
-					true);
-				auto elapsed = sw.Elapsed();
-				nosEngine.WatchLog(("AJA " + ChannelName + (IsInput() ? " DMA Read" : " DMA Write")).c_str(),
-					nos::util::Stopwatch::ElapsedString(elapsed).c_str());
-			}
-			else
+			// Only frames with packets pay for the ANC transfer
+			if (OutputAnc && OutputAnc->CountAncillaryData())
 			{
-				util::Stopwatch sw;
-				Device->DmaTransfer(NTV2_DMA_FIRST_AVAILABLE, IsInput(), 0, const_cast<ULWord*>((u32*)buffer),
-					offset, u32(bufferSize), true);
-				auto elapsed = sw.Elapsed();
-				nosEngine.WatchLog(("AJA " + ChannelName + (IsInput() ? " DMA Read" : " DMA Write")).c_str(),
-					nos::util::Stopwatch::ElapsedString(elapsed).c_str());
+				ScopedProfilerEvent _("AJA " + ChannelName + " DMA Write ANC");
+				Device->WriteOutputAnc(Channel, GetFrameBufferOffset(Channel, DoubleBufferIdx) / Device->GetFBSize(Channel), *OutputAnc, Format);
 			}
+			// Fields are not flipped, timecode is written on its own
+			if (OutputTimecode && IsFieldTransfer())
+				Device->WriteOutputFrameState(Channel, IsQuad(), std::nullopt, OutputTimecode);
 		}
 
+		LastFrameStore = DoubleBufferIdx;
+		HasCompletedFrame = true;
 		DoubleBufferIdx = NextDoubleBuffer(DoubleBufferIdx);
 
 		ULWord newVBLCount = 0;
@@ -167,10 +337,71 @@ struct DMANodeBase : NodeContext
 			Device->GetOutputVerticalInterruptCount(newVBLCount, Channel);
 
 		// DMA likely skipped a frame
-		if (curVBLCount != newVBLCount)
-			nosEngine.CallNodeFunction(NodeId, NOS_NAME("Drop"));
+		LastDMADropped = curVBLCount != newVBLCount;
+		if (LastDMADropped)
+			OnDMADrop();
 
 		NextVBL = newVBLCount + 1;
+		return true;
+	}
+
+	void TransferFrameStore(NTV2Channel channel, std::string const& label, nos::sys::vulkan::FieldType fieldType, uint8_t* buffer, nosVec2u compressedExt, size_t bufferSize)
+	{
+		ScopedProfilerEvent _(label);
+		const uint32_t pitch = compressedExt.x * 4;
+		const int fieldId = IsFieldTransfer() ? (fieldType == nos::sys::vulkan::FieldType::EVEN ? NTV2_FIELD0 : NTV2_FIELD1) : -1;
+		util::Stopwatch sw;
+		if (SeparateSquares)
+		{
+			// Four segmented transfers, each between a link's frame store and its quadrant of the raster
+			for (uint32_t link = 0; link < 4; ++link)
+				TransferSegments(NTV2Channel(channel + link), buffer, GetQuadrantSegments(link, pitch, compressedExt.y, fieldId));
+		}
+		else if (fieldId >= 0)
+		{
+			TransferSegments(channel, buffer, GetFieldSegments(pitch, compressedExt.y, fieldId));
+		}
+		else
+		{
+			Device->DmaTransfer(DMAEngine, IsInput(), 0, const_cast<ULWord*>((u32*)buffer),
+				GetFrameBufferOffset(channel, DoubleBufferIdx), u32(bufferSize), true);
+		}
+		auto elapsed = nos::util::Stopwatch::ElapsedString(sw.Elapsed());
+		if (DeferWatchLogs)
+			DeferredWatchLogs.emplace_back(label, std::move(elapsed));
+		else
+			nosEngine.WatchLog(label.c_str(), elapsed.c_str());
+	}
+
+	void TransferSegments(NTV2Channel channel, uint8_t* buffer, DMASegments const& segments)
+	{
+		Device->DmaTransfer(DMAEngine, IsInput(), 0,
+			const_cast<ULWord*>((u32*)(buffer + segments.HostOffset)),
+			GetFrameBufferOffset(channel, DoubleBufferIdx) + segments.CardOffset,
+			segments.SegmentSize,
+			segments.SegmentCount,
+			segments.HostPitch,
+			segments.CardPitch,
+			true);
+	}
+};
+
+struct DMANodeBase : NodeContext, DMAChannel
+{
+	DMANodeBase(const nosFbNode* node, DMADirection dir) : NodeContext(node), DMAChannel(dir)
+	{
+	}
+
+	virtual void OnPathStart() { ResetTransferState(); }
+
+	void OnPathStop() override
+	{
+		FrameBufferOffsets.clear();
+	}
+
+	void OnDMADrop() override
+	{
+		nosEngine.CallNodeFunction(NodeId, NOS_NAME("Drop"));
 	}
 };
 
@@ -11,6 +11,7 @@
 #include "AJADevice.h"
 #include "AJAMain.h"
 #include "DMANodeBase.hpp"
+#include "SharedFrameRing.h"
 
 namespace nos::aja
 {
@@ -20,6 +21,29 @@ struct DMAReadNodeContext : DMANodeBase
 	{
 	}
 
+	~DMAReadNodeContext() override
+	{
+		ForgetSharedBuffer();
+	}
+
+	// Buffer this node last shared its capture from, other readers must not copy from it once it may go away
+	std::shared_ptr<AJADevice> SharedDevice;
+	NTV2Channel SharedChannel = NTV2_CHANNEL_INVALID;
+	const uint8_t* SharedBuffer = nullptr;
+
+	void ForgetSharedBuffer()
+	{
+		if (SharedDevice)
+			SharedDevice->ClearCapturedFrames(SharedChannel, SharedBuffer);
+		SharedDevice = nullptr;
+		SharedBuffer = nullptr;
+	}
+
+	void OnPathStop() override
+	{
+		ForgetSharedBuffer();
+	}
+
 	nosResult ExecuteNode(nosNodeExecuteParams* params) override
 	{
 		NodeExecuteParams execParams = params;
@@ -27,6 +51,8 @@ struct DMAReadNodeContext : DMANodeBase
 		auto fieldType = *InterpretPinValue<sys::vulkan::FieldType>(*execParams[NOS_NAME_STATIC("FieldType")].Data);
 		ChannelInfo* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
 		uint32_t curVBLCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CurrentVBL")].Data);
+		auto transferMode = *InterpretPinValue<InterlacedTransferMode>(*execParams[NOS_NAME_STATIC("TransferMode")].Data);
+		auto& vblMetadata = *execParams[NOS_NAME_STATIC("VBLMetadata")].Data;
 
 		if (!channelInfo->device())
 			return NOS_RESULT_FAILED;
@@ -47,6 +73,8 @@ struct DMAReadNodeContext : DMANodeBase
 			Mode = static_cast<AJADevice::Mode>(channelInfo->input_quad_link_mode());
 		else 
 			Mode = AJADevice::SL;
+		UpdateFrameStores(channelInfo);
+		UpdateTransferMode(transferMode, GetVBLMetadata(vblMetadata, channelInfo));
 		auto [_, bufferSize] = GetDMAInfo();
 
 		if (!bufferToWrite.Memory.Handle)
@@ -66,14 +94,140 @@ struct DMAReadNodeContext : DMANodeBase
 		if (curVBLCount == 0)
 			Device->GetInputVerticalInterruptCount(curVBLCount, Channel);
 
-		DMATransfer(fieldType, curVBLCount, buffer, inputBufferSize);
+		bool shareCapture = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("ShareCapture")].Data);
+		UpdateExport(InterpretPinValue<const char>(*execParams[NOS_NAME_STATIC("Export")].Data),
+					 *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("ExportSlots")].Data),
+					 channelInfo, inputBufferSize, execParams[NOS_NAME_STATIC("ExportPath")].Id);
+
+		// Exported frames are stamped on the host clock, which readers in other processes share: when Wait VBL saw the
+		// VBL, or without its metadata, when the frame was about to be transferred
+		const auto* vbl = GetVBLMetadata(vblMetadata, channelInfo);
+		const uint64_t exportTimestamp = vbl && vbl->wakeup_ns() ? vbl->wakeup_ns()
+			: uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+		// When exporting, the frame is captured into the shared slot and copied from there
+		uint8_t* exportSlot = Export ? Export->BeginWrite() : nullptr;
+		bool captured = false;
+		if (shareCapture)
+			captured = SharedDMATransfer(fieldType, curVBLCount, buffer, inputBufferSize);
+		else
+			captured = DMATransfer(fieldType, curVBLCount, exportSlot ? exportSlot : buffer, inputBufferSize);
+		if (exportSlot)
+		{
+			if (captured)
+			{
+				ScopedProfilerEvent _("AJA " + ChannelName + " Export Copy");
+				if (shareCapture)
+					memcpy(exportSlot, buffer, inputBufferSize);
+				else
+					memcpy(buffer, exportSlot, inputBufferSize);
+			}
+			Export->EndWrite(captured, curVBLCount, exportTimestamp, uint32_t(IsFieldTransfer() ? fieldType : sys::vulkan::FieldType::PROGRESSIVE));
+		}
 
-		bufferToWrite.Info.Buffer.FieldType = (nosTextureFieldType)fieldType;
+		// In PerFrame mode the buffer holds both fields woven together, starting with the even field.
+		bufferToWrite.Info.Buffer.FieldType = (nosTextureFieldType)(IsFieldTransfer() ? fieldType : sys::vulkan::FieldType::PROGRESSIVE);
+		auto fieldOrder = IsInterlaced() && !IsFieldTransfer() ? sys::vulkan::FieldType::EVEN : sys::vulkan::FieldType::PROGRESSIVE;
 
 		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Output")].Id, Buffer::From(vkss::ConvertBufferInfo(bufferToWrite)));
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("FieldOrder")].Id, Buffer::From(fieldOrder));
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Metadata")].Id,
+							  Buffer::From(MakeFrameMetadata(vblMetadata, channelInfo, curVBLCount, bufferToWrite.Info.Buffer.FieldType, captured)));
 
 		return NOS_RESULT_SUCCESS;
 	}
+
+	// The first reader of this channel in a VBL does the DMA into its own buffer and the other readers copy from it,
+	// so the frame crosses PCIe once no matter how many DMARead nodes consume it, and a single reader copies nothing.
+	bool SharedDMATransfer(sys::vulkan::FieldType fieldType, uint32_t curVBLCount, uint8_t* buffer, uint64_t inputBufferSize)
+	{
+		if (SharedBuffer && (SharedBuffer != buffer || SharedDevice != Device || SharedChannel != Channel))
+			ForgetSharedBuffer();
+		bool owner = false;
+		ScopedProfilerEvent _("AJA " + ChannelName + " Shared Capture");
+		bool filled = Device->ShareCapturedFrame(Channel, curVBLCount, buffer, inputBufferSize, [&](AJADevice::CapturedFrame& captured, AJADevice::CapturedFrame const* previous) {
+			// Continue the frame store sequence of whichever reader captured last, unless the stream was interrupted
+			if (previous && curVBLCount - previous->VBLCount <= 4)
+			{
+				DoubleBufferIdx = previous->DoubleBufferIdx;
+				NextVBL = previous->NextVBL;
+				NeedsFrameSet = false;
+			}
+			owner = true;
+			if (!DMATransfer(fieldType, curVBLCount, buffer, inputBufferSize))
+				return false;
+			captured.DoubleBufferIdx = DoubleBufferIdx;
+			captured.NextVBL = NextVBL;
+			return true;
+		});
+		if (owner)
+		{
+			SharedDevice = Device;
+			SharedChannel = Channel;
+			SharedBuffer = buffer;
+		}
+		return filled;
+	}
+
+	// Metadata of the VBL of this input, null if it is not connected or belongs to another channel
+	const FrameMetadata* GetVBLMetadata(nosBuffer const& vblMetadata, const ChannelInfo* channelInfo)
+	{
+		if (!vblMetadata.Size)
+			return nullptr;
+		auto* vbl = InterpretPinValue<FrameMetadata>(vblMetadata);
+		if (vbl->device_serial() == channelInfo->device()->serial_number() && vbl->channel() == uint32_t(Channel) && vbl->is_input())
+			return vbl;
+		return nullptr;
+	}
+
+	// Extends the metadata of the VBL with the result of the transfer. Metadata of another channel is not carried over.
+	TFrameMetadata MakeFrameMetadata(nosBuffer const& vblMetadata, const ChannelInfo* channelInfo, uint32_t curVBLCount, nosTextureFieldType fieldType, bool captured)
+	{
+		TFrameMetadata metadata{};
+		if (auto* vbl = GetVBLMetadata(vblMetadata, channelInfo))
+			vbl->UnPackTo(&metadata);
+		metadata.device_serial = channelInfo->device()->serial_number();
+		metadata.channel = Channel;
+		metadata.is_input = true;
+		metadata.vbl_count = curVBLCount;
+		metadata.field_type = uint32_t(fieldType);
+		metadata.dma_dropped = captured && LastDMADropped;
+		metadata.ring_index = LastFrameStore;
+		metadata.transfer_mode = TransferMode;
+		return metadata;
+	}
+
+	// Frames exported to other processes, see SharedFrameRing.h
+	std::unique_ptr<SharedFrameRing> Export;
+
+	void UpdateExport(std::string const& name, uint32_t slotCount, const ChannelInfo* channelInfo, uint64_t frameSize, nosUUID exportPathPinId)
+	{
+		SharedFrameRing::Format format{.PixelFormat = uint32_t(PixelFormat),
+									   .VideoFormat = uint32_t(Format),
+									   .FieldTransfer = IsFieldTransfer(),
+									   .FrameSize = frameSize};
+		if (auto* resolution = channelInfo->resolution())
+		{
+			format.Width = resolution->x();
+			format.Height = resolution->y();
+		}
+		if (name.empty() ? !Export : (Export && Export->Matches(name, format, slotCount)))
+			return;
+		Export.reset();
+		if (!name.empty())
+		{
+			Export = std::make_unique<SharedFrameRing>(name, format, slotCount);
+			if (!Export->IsOpen())
+			{
+				nosEngine.LogE("DMA Read: Unable to create shared frame ring %s.", name.c_str());
+				Export.reset();
+			}
+			else
+				nosEngine.LogI("DMA Read: Exporting %s to %s", ChannelName.c_str(), Export->GetPath().c_str());
+		}
+		std::string path = Export ? Export->GetPath() : "";
+		nosEngine.SetPinValue(exportPathPinId, nosBuffer{.Data = (void*)path.c_str(), .Size = path.size() + 1});
+	}
 };
 
 nosResult RegisterDMAReadNode(nosNodeFunctions* functions)
@@ -0,0 +1,53 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+namespace nos::aja
+{
+// One segmented DMA: SegmentCount runs of SegmentSize bytes, HostPitch apart in host memory and CardPitch apart in the
+// frame store. Offsets are from the start of the host buffer and of the frame store.
+struct DMASegments
+{
+	uint64_t HostOffset = 0;
+	uint32_t CardOffset = 0;
+	uint32_t SegmentSize = 0;
+	uint32_t SegmentCount = 0;
+	uint32_t HostPitch = 0;
+	uint32_t CardPitch = 0;
+};
+
+// A field of an interleaved frame store into a host buffer holding only that field. lineCount is the lines of the field.
+inline DMASegments GetFieldSegments(uint32_t linePitch, uint32_t lineCount, uint32_t field)
+{
+	return {.HostOffset = 0,
+			.CardOffset = field * linePitch,
+			.SegmentSize = linePitch,
+			.SegmentCount = lineCount,
+			.HostPitch = linePitch,
+			.CardPitch = linePitch * 2};
+}
+
+// A quadrant of a square division raster, kept in the frame store of its link, into its place in a host buffer
+// holding the whole raster. Quadrants are numbered by link: 0 top left, 1 top right, 2 bottom left, 3 bottom right.
+// linePitch and lineCount are of the host raster, lineCount counts the lines of one field for field transfers.
+// field is 0 or 1 for field transfers, negative for frames.
+inline DMASegments GetQuadrantSegments(uint32_t quadrant, uint32_t linePitch, uint32_t lineCount, int field = -1)
+{
+	const uint32_t quadrantPitch = linePitch / 2;
+	const uint32_t quadrantLines = lineCount / 2;
+	DMASegments segments{.HostOffset = uint64_t(quadrant / 2) * quadrantLines * linePitch + (quadrant % 2) * quadrantPitch,
+						 .CardOffset = 0,
+						 .SegmentSize = quadrantPitch,
+						 .SegmentCount = quadrantLines,
+						 .HostPitch = linePitch,
+						 .CardPitch = quadrantPitch};
+	if (field >= 0)
+	{
+		segments.CardOffset = uint32_t(field) * quadrantPitch;
+		segments.CardPitch = quadrantPitch * 2;
+	}
+	return segments;
+}
+} // namespace nos::aja
@@ -11,6 +11,7 @@
 #include "AJADevice.h"
 #include "AJAMain.h"
 #include "DMANodeBase.hpp"
+#include "Cadence.h"
 
 namespace nos::aja
 {
@@ -21,13 +22,40 @@ struct DMAWriteNodeContext : DMANodeBase
 	{
 	}
 
+	~DMAWriteNodeContext() override
+	{
+		CloseQueue();
+	}
+
 	nos::Buffer LastChannelInfo = {};
+	AJAAncillaryList AncList;
+	uint32_t Repeats = 0;
+
+	// Pre-roll: frames go to an output queue and are flipped to at their target VBLs
+	std::shared_ptr<AJADevice> QueueDevice;
+	std::shared_ptr<AJADevice::OutputQueue> Queue;
+	NTV2VideoFormat QueueFormat = NTV2_FORMAT_UNKNOWN;
+	uint32_t PrerollDepth = 0;
+	ULWord LastTarget = 0;
+	uint32_t QueuedFrames = 0;
+	uint32_t LateFrames = 0;
+	uint32_t LastSpan = 1; // VBLs the last queued frame stays on air for
+
+	// Cross-rate output: the graph runs at RenderRate and frames are queued at the VBLs the cadence gives them
+	NTV2FrameRate RenderRate = NTV2_FRAMERATE_INVALID;
+	NTV2FrameRate QueueRenderRate = NTV2_FRAMERATE_INVALID;
+	CadenceScheduler Cadence;
+
+	bool UsesCadence() const
+	{
+		return RenderRate != NTV2_FRAMERATE_INVALID && RenderRate != GetNTV2FrameRateFromVideoFormat(Format);
+	}
 
 	void GetScheduleInfo(nosScheduleInfo* out) override
 	{
 		*out = nosScheduleInfo{
 			.Importance = 1,
-			.DeltaSeconds = GetDeltaSeconds(Format, IsInterlaced()),
+			.DeltaSeconds = UsesCadence() ? GetDeltaSeconds(RenderRate) : GetDeltaSeconds(Format, IsFieldTransfer()),
 			.Type = NOS_SCHEDULE_TYPE_ON_DEMAND,
 		};
 	}
@@ -55,29 +83,95 @@ struct DMAWriteNodeContext : DMANodeBase
 				Mode = static_cast<AJADevice::Mode>(channelInfo->output_quad_link_mode());
 			else
 				Mode = AJADevice::SL;
+			UpdateFrameStores(channelInfo);
+			nosEngine.RecompilePath(NodeId);
+		}
+		else if (pinName == NOS_NAME_STATIC("RenderRate"))
+		{
+			std::string text = InterpretPinValue<const char>(value);
+			NTV2FrameRate renderRate = NTV2_FRAMERATE_INVALID;
+			for (int i = 0; i < NTV2_NUM_FRAMERATES && !text.empty(); ++i)
+				if (NTV2FrameRateToString(NTV2FrameRate(i), true) == text)
+					renderRate = NTV2FrameRate(i);
+			if (!text.empty() && renderRate == NTV2_FRAMERATE_INVALID)
+				nosEngine.LogW("DMA Write: %s is not a frame rate, the output's rate is used.", text.c_str());
+			if (renderRate == RenderRate)
+				return;
+			RenderRate = renderRate;
 			nosEngine.RecompilePath(NodeId);
 		}
 	}
 	
 	nosResult ExecuteNode(nosNodeExecuteParams* params) override
 	{
+		const auto executeStart = std::chrono::steady_clock::now();
 		nosResourceShareInfo inputBuffer{};
+		nosResourceShareInfo keyBuffer{};
 		auto fieldType = nos::sys::vulkan::FieldType::UNKNOWN;
 		uint32_t curVBLCount = 0;
+		const FrameMetadata* metadata = nullptr;
+		std::string timecodeText;
+		const flatbuffers::Vector<flatbuffers::Offset<AncPacket>>* ancPackets = nullptr;
+		nosUUID repeatsPinId{};
+		nosUUID queuedFramesPinId{};
+		nosUUID lateFramesPinId{};
+		uint32_t prerollDepth = 0;
+		uint32_t targetVBL = 0;
+		uint64_t targetTimestamp = 0;
+		auto transferMode = InterlacedTransferMode::PerField;
 		for (size_t i = 0; i < params->PinCount; ++i)
 		{
 			auto& pin = params->Pins[i];
 			if (pin.Name == NOS_NAME_STATIC("Input"))
 				inputBuffer = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*pin.Data));
+			if (pin.Name == NOS_NAME_STATIC("Key"))
+				keyBuffer = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*pin.Data));
 			if (pin.Name == NOS_NAME("FieldType"))
 				fieldType = *InterpretPinValue<sys::vulkan::FieldType>(*pin.Data);
 			if (pin.Name == NOS_NAME("CurrentVBL"))
 				curVBLCount = *InterpretPinValue<uint32_t>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("Metadata") && pin.Data->Size)
+				metadata = InterpretPinValue<FrameMetadata>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("Timecode"))
+				timecodeText = InterpretPinValue<const char>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("AncPackets") && pin.Data->Size)
+				ancPackets = InterpretPinValue<flatbuffers::Vector<flatbuffers::Offset<AncPacket>>>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("RepeatOnUnderrun"))
+				RepeatOnUnderrun = *InterpretPinValue<bool>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("Repeats"))
+				repeatsPinId = pin.Id;
+			if (pin.Name == NOS_NAME_STATIC("PrerollDepth"))
+				prerollDepth = *InterpretPinValue<uint32_t>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("TargetVBL"))
+				targetVBL = *InterpretPinValue<uint32_t>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("TargetTimestamp"))
+				targetTimestamp = *InterpretPinValue<uint64_t>(*pin.Data);
+			if (pin.Name == NOS_NAME_STATIC("QueuedFrames"))
+				queuedFramesPinId = pin.Id;
+			if (pin.Name == NOS_NAME_STATIC("LateFrames"))
+				lateFramesPinId = pin.Id;
+			if (pin.Name == NOS_NAME_STATIC("TransferMode"))
+				transferMode = *InterpretPinValue<InterlacedTransferMode>(*pin.Data);
 		}
 
 		if (!inputBuffer.Memory.Handle || !Device || Format == NTV2_FORMAT_UNKNOWN)
 			return NOS_RESULT_FAILED;
 
+		// Metadata of this output's VBL replaces the separate VBL count and field pins
+		if (metadata && !metadata->is_input() && metadata->channel() == uint32_t(Channel) &&
+			metadata->device_serial() == Device->GetSerialNumber() && metadata->vbl_count())
+		{
+			curVBLCount = metadata->vbl_count();
+			fieldType = sys::vulkan::FieldType(metadata->field_type());
+		}
+		else
+		{
+			metadata = nullptr;
+		}
+		// The period of the node depends on it
+		if (UpdateTransferMode(transferMode, metadata))
+			nosEngine.RecompilePath(NodeId);
+
 		auto buffer = nosVulkan->Map(&inputBuffer);
 		auto inputSize = inputBuffer.Memory.Size;
 
@@ -89,7 +183,98 @@ struct DMAWriteNodeContext : DMANodeBase
 		if (curVBLCount == 0)
 			Device->GetOutputVerticalInterruptCount(curVBLCount, Channel);
 
-		DMATransfer(fieldType, curVBLCount, buffer, inputSize);
+		uint8_t* key = nullptr;
+		if (HasKey())
+		{
+			if (!keyBuffer.Memory.Handle || keyBuffer.Memory.Size != inputSize)
+				nosEngine.LogW("DMA Write: Key buffer is missing or does not match the fill buffer, key is not updated.");
+			else
+				key = nosVulkan->Map(&keyBuffer);
+		}
+
+		NTV2_RP188 timecode;
+		if (!timecodeText.empty())
+		{
+			if (AJADevice::EncodeTimecode(timecodeText, Format, timecode))
+				OutputTimecode = &timecode;
+			else
+				nosEngine.LogW("DMA Write: %s is not a valid timecode.", timecodeText.c_str());
+		}
+		AncList.Clear();
+		if (ancPackets)
+		{
+			for (auto* packet : *ancPackets)
+			{
+				AJAAncillaryData data;
+				data.SetDID(packet->did());
+				data.SetSID(packet->sdid());
+				if (packet->data())
+					data.SetPayloadData(packet->data()->data(), packet->data()->size());
+				data.SetDataCoding(AJAAncDataCoding_Digital);
+				data.SetLocationLineNumber(packet->line());
+				data.SetLocationDataChannel(packet->chroma() ? AJAAncDataChannel_C : AJAAncDataChannel_Y);
+				data.SetLocationHorizOffset(AJAAncDataHorizOffset_AnyVanc);
+				AncList.AddAncillaryData(data);
+			}
+			OutputAnc = &AncList;
+		}
+
+		// Repeated frames of a cadence are held in their frame stores by the output queue
+		if (UsesCadence())
+			prerollDepth = std::max(prerollDepth, 2u);
+		if (prerollDepth && OpenQueue(prerollDepth))
+		{
+			uint32_t span = 1;
+			if (UsesCadence())
+			{
+				const nosVec2u renderPeriod = GetDeltaSeconds(RenderRate);
+				const nosVec2u outputPeriod = GetDeltaSeconds(Format, false);
+				Cadence.Configure(renderPeriod.x, renderPeriod.y, outputPeriod.x, outputPeriod.y);
+				span = Cadence.Next();
+			}
+			if (span) // Otherwise the output is slower and the cadence skips this frame
+				QueueTransfer(buffer, inputSize, key, targetVBL, targetTimestamp, span);
+		}
+		else
+		{
+			CloseQueue();
+			if (!prerollDepth)
+				SetQueueStatus({}, fb::NodeStatusMessageType::INFO);
+			const uint64_t repeatedFrames = RepeatedFrames;
+			VBLWakeupNs = metadata ? metadata->wakeup_ns() : 0;
+			DMATransfer(fieldType, curVBLCount, buffer, inputSize, key);
+			if (metadata && metadata->wakeup_ns())
+			{
+				// How long after the VBL the frame was there to transfer
+				const nosVec2u deltaSeconds = GetDeltaSeconds(Format, IsFieldTransfer());
+				const double periodNs = 1e9 * deltaSeconds.x / deltaSeconds.y;
+				const auto startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(executeStart.time_since_epoch()).count();
+				const float waitFrames = float(double(startNs - int64_t(metadata->wakeup_ns())) / periodNs);
+				const bool dropped = LastDMADropped || RepeatedFrames != repeatedFrames || metadata->dropped_vbls();
+				Device->GetBufferingController(Channel).AddFrame(waitFrames, dropped);
+			}
+		}
+		OutputTimecode = nullptr;
+		OutputAnc = nullptr;
+		if (Queue)
+		{
+			uint32_t queuedFrames = uint32_t(Queue->GetQueuedCount());
+			if (queuedFrames != QueuedFrames)
+			{
+				QueuedFrames = queuedFrames;
+				nosEngine.SetPinValue(queuedFramesPinId, Buffer::From(QueuedFrames));
+			}
+			if (uint32_t(Queue->LateFrames) != LateFrames)
+			{
+				LateFrames = uint32_t(Queue->LateFrames);
+				nosEngine.SetPinValue(lateFramesPinId, Buffer::From(LateFrames));
+			}
+		}
+		if (uint32_t(RepeatedFrames) != Repeats)
+		{
+			Repeats = uint32_t(RepeatedFrames);
+			nosEngine.SetPinValue(repeatsPinId, Buffer::From(Repeats));
+		}
 
 		nosScheduleNodeParams schedule {
 			.NodeId = NodeId,
@@ -100,6 +285,161 @@ struct DMAWriteNodeContext : DMANodeBase
 		return NOS_RESULT_SUCCESS;
 	}
 
+	bool OpenQueue(uint32_t depth)
+	{
+		if (Queue && !Queue->Stop && QueueDevice == Device && Queue->Channel == Channel && QueueFormat == Format && PrerollDepth == depth &&
+			QueueRenderRate == RenderRate)
+			return true;
+		CloseQueue();
+		if (IsInterlaced())
+		{
+			SetQueueStatus("Pre-roll needs a progressive output", fb::NodeStatusMessageType::WARNING);
+			return false;
+		}
+		if (SeparateSquares)
+		{
+			SetQueueStatus("Pre-roll needs a quad frame store, turn off Separate Squares", fb::NodeStatusMessageType::WARNING);
+			return false;
+		}
+		// One store on air, one going off air at the next VBL and the rest for queued frames
+		const uint32_t storeCount = std::min(depth + 2, GetMaxFrameStores());
+		if (storeCount < 3)
+		{
+			SetQueueStatus("No card memory left for pre-roll", fb::NodeStatusMessageType::WARNING);
+			return false;
+		}
+		if (NeedsFrameSet)
+		{
+			DoubleBufferIdx = StartDoubleBuffer();
+			NeedsFrameSet = false;
+		}
+		std::vector<ULWord> fillFrames, keyFrames;
+		for (uint32_t store = 0; store < storeCount; ++store)
+		{
+			fillFrames.push_back(GetFrameBufferOffset(Channel, uint8_t(store)) / Device->GetFBSize(Channel));
+			if (HasKey())
+				keyFrames.push_back(GetFrameBufferOffset(KeyChannel, uint8_t(store)) / Device->GetFBSize(KeyChannel));
+		}
+		// Double buffering leaves the output on the store it flipped to last, store 1 before the first frame
+		const uint8_t shownStore = HasCompletedFrame ? LastFrameStore : 1;
+		Queue = Device->OpenOutputQueue(Channel, KeyChannel, IsQuad(), std::move(fillFrames), std::move(keyFrames), shownStore);
+		if (!Queue)
+		{
+			SetQueueStatus("Output queue of the channel is in use", fb::NodeStatusMessageType::FAILURE);
+			return false;
+		}
+		QueueDevice = Device;
+		QueueFormat = Format;
+		PrerollDepth = depth;
+		QueueRenderRate = RenderRate;
+		LastTarget = 0;
+		LastSpan = 1;
+		Cadence.Reset();
+		std::string status = "Pre-roll: " + std::to_string(storeCount - 2) + " frames";
+		if (UsesCadence())
+			status += ", " + NTV2FrameRateToString(RenderRate, true) + " fps on " + NTV2FrameRateToString(GetNTV2FrameRateFromVideoFormat(Format), true) + " Hz";
+		SetQueueStatus(status, fb::NodeStatusMessageType::INFO);
+		return true;
+	}
+
+	void CloseQueue()
+	{
+		if (!Queue)
+			return;
+		QueueDevice->CloseOutputQueue(Queue);
+		Queue = nullptr;
+		QueueDevice = nullptr;
+		PrerollDepth = 0;
+		// Double buffering starts over, the queue may have left the output on any of its stores
+		NeedsFrameSet = true;
+		HasCompletedFrame = false;
+	}
+
+	std::string QueueStatus;
+	void SetQueueStatus(std::string text, fb::NodeStatusMessageType type)
+	{
+		if (text == QueueStatus)
+			return;
+		QueueStatus = text;
+		if (text.empty())
+			SetNodeStatusMessages({});
+		else
+			SetNodeStatusMessages({fb::TNodeStatusMessage{{}, std::move(text), type}});
+	}
+
+	// Target timestamps are on the clock of the VBL timestamps in frame metadata
+	ULWord TimestampToVBL(uint64_t timestampNs, ULWord vblCount)
+	{
+		const uint64_t vblTimestampNs = Device->GetLastOutputVerticalInterruptTimestamp(Channel);
+		const nosVec2u deltaSeconds = GetDeltaSeconds(Format, false);
+		const double periodNs = 1e9 * deltaSeconds.x / deltaSeconds.y;
+		const int64_t frames = std::llround(double(int64_t(timestampNs - vblTimestampNs)) / periodNs);
+		return ULWord(std::max<int64_t>(int64_t(vblCount) + frames, 1));
+	}
+
+	// span: VBLs the frame stays on air for when the next frame has no target of its own
+	void QueueTransfer(uint8_t* buffer, uint64_t inputBufferSize, uint8_t* keyBuffer, ULWord targetVBL, uint64_t targetTimestamp, uint32_t span)
+	{
+		auto [compressedExt, bufferSize] = GetDMAInfo();
+		if (bufferSize != inputBufferSize)
+		{
+			nosEngine.LogE("DMATransfer buffer size mismatch");
+			return;
+		}
+		// Blocks while the queue is full, which holds the renderer back to the pre-roll depth
+		std::optional<uint8_t> store;
+		{
+			ScopedProfilerEvent _("AJA " + ChannelName + " Output Queue Wait");
+			store = Queue->AcquireStore(std::chrono::seconds(1));
+		}
+		if (!store)
+		{
+			nosEngine.LogW("DMA Write: Output queue of %s did not drain, frame is dropped.", ChannelName.c_str());
+			return;
+		}
+
+		ULWord vblCount = 0;
+		Device->GetOutputVerticalInterruptCount(vblCount, Channel);
+		ULWord target = targetVBL;
+		if (!target && targetTimestamp)
+			target = TimestampToVBL(targetTimestamp, vblCount);
+		// Frames without a target follow the previous one, or start a new pre-roll when that one is not ahead anymore
+		if (!target)
+			target = LastTarget + LastSpan >= vblCount + 2 ? LastTarget + LastSpan : vblCount + 1 + PrerollDepth;
+		// The queue flips one VBL ahead of the target, and may already be past that VBL
+		if (target < vblCount + 2)
+		{
+			Queue->ReleaseStore(*store);
+			++Queue->LateFrames;
+			OnDMADrop();
+			return;
+		}
+
+		DoubleBufferIdx = *store;
+		TransferFrameStore(Channel, "AJA " + ChannelName + " DMA Write", sys::vulkan::FieldType::PROGRESSIVE, buffer, compressedExt, bufferSize);
+		if (HasKey() && keyBuffer)
+			TransferFrameStore(KeyChannel, "AJA " + ChannelName + " DMA Write Key", sys::vulkan::FieldType::PROGRESSIVE, keyBuffer, compressedExt, bufferSize);
+		if (OutputAnc && OutputAnc->CountAncillaryData())
+		{
+			ScopedProfilerEvent _("AJA " + ChannelName + " DMA Write ANC");
+			Device->WriteOutputAnc(Channel, GetFrameBufferOffset(Channel, *store) / Device->GetFBSize(Channel), *OutputAnc, Format);
+		}
+		LastTarget = target;
+		LastSpan = span;
+		Queue->Push({.Store = *store, .TargetVBL = target, .Timecode = OutputTimecode ? std::optional(*OutputTimecode) : std::nullopt});
+	}
+
+	void OnPathStop() override
+	{
+		CloseQueue();
+		DMANodeBase::OnPathStop();
+	}
+
+	void OnRepeat() override
+	{
+		nosEngine.WatchLog(("AJA " + ChannelName + " Repeated Frames").c_str(), std::to_string(RepeatedFrames).c_str());
+	}
+
 	void OnPathStart() override
 	{
 		DMANodeBase::OnPathStart();
@@ -0,0 +1,105 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "FrameSync.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace nos::aja
+{
+std::shared_ptr<FrameSyncRing> FrameSyncRing::Get(std::string const& name)
+{
+	static std::mutex mutex;
+	static std::unordered_map<std::string, std::weak_ptr<FrameSyncRing>> rings;
+	std::unique_lock lock(mutex);
+	auto& weak = rings[name];
+	auto ring = weak.lock();
+	if (!ring)
+	{
+		ring = std::make_shared<FrameSyncRing>();
+		weak = ring;
+	}
+	std::erase_if(rings, [](auto const& entry) { return entry.second.expired(); });
+	return ring;
+}
+
+void FrameSyncRing::SetSlotCount(uint32_t slotCount)
+{
+	slotCount = std::max(slotCount, 2u);
+	std::unique_lock lock(Mutex);
+	if (Slots.size() == slotCount)
+		return;
+	// Slots being read or written are kept, the rest are dropped or added
+	size_t excess = Slots.size() > slotCount ? Slots.size() - slotCount : 0;
+	std::erase_if(Slots, [&](auto const& slot) {
+		if (!excess || slot->Readers || slot.get() == Writing)
+			return false;
+		--excess;
+		return true;
+	});
+	while (Slots.size() < slotCount)
+		Slots.push_back(std::make_unique<Slot>());
+}
+
+uint8_t* FrameSyncRing::BeginWrite(size_t size)
+{
+	std::unique_lock lock(Mutex);
+	Slot* oldest = nullptr;
+	for (auto& slot : Slots)
+		if (!slot->Readers && slot.get() != Writing && (!oldest || slot->Info.Sequence < oldest->Info.Sequence))
+			oldest = slot.get();
+	if (!oldest)
+		return nullptr;
+	oldest->Info = {};
+	Writing = oldest;
+	lock.unlock();
+	Writing->Data.resize(size);
+	return Writing->Data.data();
+}
+
+void FrameSyncRing::EndWrite(FrameInfo info)
+{
+	std::unique_lock lock(Mutex);
+	if (!Writing)
+		return;
+	info.Sequence = ++LastSequence;
+	Writing->Info = info;
+	Writing = nullptr;
+}
+
+std::vector<FrameSyncRing::FrameInfo> FrameSyncRing::GetFrames()
+{
+	std::vector<FrameInfo> frames;
+	{
+		std::unique_lock lock(Mutex);
+		for (auto& slot : Slots)
+			if (slot->Info.Sequence)
+				frames.push_back(slot->Info);
+	}
+	std::sort(frames.begin(), frames.end(), [](FrameInfo const& a, FrameInfo const& b) { return a.Sequence < b.Sequence; });
+	return frames;
+}
+
+uint8_t const* FrameSyncRing::BeginRead(uint64_t sequence, size_t& size)
+{
+	std::unique_lock lock(Mutex);
+	for (auto& slot : Slots)
+	{
+		if (slot->Info.Sequence == sequence)
+		{
+			++slot->Readers;
+			size = slot->Data.size();
+			return slot->Data.data();
+		}
+	}
+	return nullptr;
+}
+
+void FrameSyncRing::EndRead(uint64_t sequence)
+{
+	std::unique_lock lock(Mutex);
+	for (auto& slot : Slots)
+		if (slot->Info.Sequence == sequence && slot->Readers)
+			--slot->Readers;
+}
+} // namespace nos::aja
@@ -0,0 +1,90 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace nos::aja
+{
+// Frame synchronizer
+// ------------------
+// Frames of an input that is not locked to the output reference go through a small host ring. The output side takes
+// one frame per output VBL, chosen by the VBL timestamps of both sides: when the input runs slower a frame is shown
+// twice, when it runs faster one is skipped. Only whole frames are repeated or skipped, so fields of an interlaced
+// frame always go out together.
+class FrameSyncRing
+{
+public:
+	struct FrameInfo
+	{
+		uint64_t Sequence = 0; // Counted from 1 by the ring
+		uint64_t DeviceSerial = 0;
+		uint64_t TimestampNs = 0; // Driver's timestamp of the input VBL
+		uint64_t WakeupNs = 0; // Host steady clock, for comparing with the VBLs of another device
+		uint32_t VBLCount = 0;
+		uint32_t FieldType = 0; // nos.sys.vulkan.FieldType of the buffer, PROGRESSIVE for woven interlaced frames
+	};
+
+	// Rings are shared by name within the process, the writer and the readers of a ring find each other by it
+	static std::shared_ptr<FrameSyncRing> Get(std::string const& name);
+
+	// Writer. Overwrites the oldest frame no reader is using, frames in use are skipped.
+	void SetSlotCount(uint32_t slotCount);
+	uint8_t* BeginWrite(size_t size);
+	void EndWrite(FrameInfo info);
+
+	// Readers. Published frames, oldest first.
+	std::vector<FrameInfo> GetFrames();
+	// Keeps the frame from being overwritten until EndRead, nullptr if it was overwritten already
+	uint8_t const* BeginRead(uint64_t sequence, size_t& size);
+	void EndRead(uint64_t sequence);
+
+private:
+	struct Slot
+	{
+		std::vector<uint8_t> Data;
+		FrameInfo Info; // Sequence is 0 while the slot is empty or being written
+		uint32_t Readers = 0;
+	};
+	std::mutex Mutex;
+	std::vector<std::unique_ptr<Slot>> Slots;
+	Slot* Writing = nullptr;
+	uint64_t LastSequence = 0;
+};
+
+// Frame to show at targetNs, on the same clock as timeOf. previous is the frame shown at the output's last VBL, 0 at
+// start. The next frame is taken when it is due within hysteresis input periods; earlier than that the previous one
+// is repeated, more than a period later the overdue frames are skipped.
+template <typename TimeOf>
+std::optional<uint64_t> PickSyncFrame(std::span<FrameSyncRing::FrameInfo const> frames, uint64_t previous, int64_t targetNs, int64_t inputPeriodNs, double hysteresis, TimeOf&& timeOf)
+{
+	if (frames.empty())
+		return std::nullopt;
+	auto due = [&](FrameSyncRing::FrameInfo const& frame) { return double(targetNs - int64_t(timeOf(frame))) / double(inputPeriodNs); };
+	if (!previous)
+	{
+		// Newest frame that is due, or the oldest if none is
+		for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+			if (due(*it) >= 0)
+				return it->Sequence;
+		return frames.front().Sequence;
+	}
+	size_t next = 0;
+	while (next < frames.size() && frames[next].Sequence <= previous)
+		++next;
+	const bool hasPrevious = next && frames[next - 1].Sequence == previous;
+	if (next == frames.size()) // Input is late
+		return hasPrevious ? previous : frames.back().Sequence;
+	if (due(frames[next]) < -hysteresis && hasPrevious)
+		return previous;
+	while (next + 1 < frames.size() && due(frames[next]) > 1 + hysteresis && due(frames[next + 1]) >= -hysteresis)
+		++next;
+	return frames[next].Sequence;
+}
+} // namespace nos::aja
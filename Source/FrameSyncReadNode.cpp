@@ -0,0 +1,165 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosVulkanSubsystem/Helpers.hpp>
+
+#include "AJA_generated.h"
+#include "AJAMain.h"
+#include "FrameSync.h"
+
+namespace nos::aja
+{
+
+// Output side of a frame synchronizer. At each output VBL copies the input frame due at that VBL from the named ring,
+// repeating or skipping whole frames as the input drifts against the output. See FrameSync.h.
+struct FrameSyncReadNodeContext : NodeContext
+{
+	// Input frames are taken over only when due by more than this fraction of a frame, so that a source running at
+	// nearly the same rate doesn't alternate between repeats and skips around the boundary
+	static constexpr double Hysteresis = 0.25;
+
+	FrameSyncReadNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		nosResourceShareInfo bufferToWrite = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*execParams[NOS_NAME_STATIC("BufferToWrite")].Data));
+		auto& metadataBuffer = *execParams[NOS_NAME_STATIC("Metadata")].Data;
+		std::string name = InterpretPinValue<const char>(*execParams[NOS_NAME_STATIC("Name")].Data);
+		uint32_t delay = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("Delay")].Data);
+
+		if (name.empty() || !bufferToWrite.Memory.Handle)
+			return NOS_RESULT_FAILED;
+		if (!Ring || name != Name)
+		{
+			Ring = FrameSyncRing::Get(name);
+			Name = name;
+			Previous = 0;
+		}
+
+		const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		uint64_t outputSerial = 0;
+		int64_t vblNs = now, wakeupNs = now;
+		uint32_t vblCount = 0;
+		bool interlaced = false, secondField = false;
+		if (metadataBuffer.Size)
+		{
+			auto* metadata = InterpretPinValue<FrameMetadata>(metadataBuffer);
+			outputSerial = metadata->device_serial();
+			vblCount = metadata->vbl_count();
+			if (metadata->timestamp_ns())
+				vblNs = int64_t(metadata->timestamp_ns());
+			if (metadata->wakeup_ns())
+				wakeupNs = int64_t(metadata->wakeup_ns());
+			auto fieldType = sys::vulkan::FieldType(metadata->field_type());
+			interlaced = fieldType == sys::vulkan::FieldType::EVEN || fieldType == sys::vulkan::FieldType::ODD;
+			secondField = fieldType == sys::vulkan::FieldType::ODD;
+		}
+
+		auto frames = Ring->GetFrames();
+		if (frames.empty())
+			return NOS_RESULT_FAILED;
+		// Driver timestamps are comparable only between channels of one card, across cards the host clock is used
+		const bool sameDevice = outputSerial && frames.back().DeviceSerial == outputSerial && frames.back().TimestampNs;
+		auto timeOf = [sameDevice](FrameSyncRing::FrameInfo const& frame) { return sameDevice ? frame.TimestampNs : frame.WakeupNs; };
+		const int64_t outputNs = sameDevice ? vblNs : wakeupNs;
+
+		const int64_t outputPeriod = UpdateOutputPeriod(outputNs, vblCount) * (interlaced ? 2 : 1);
+		int64_t inputPeriod = outputPeriod;
+		if (frames.size() >= 2 && frames.back().Sequence > frames.front().Sequence)
+			inputPeriod = std::max<int64_t>(int64_t(timeOf(frames.back()) - timeOf(frames.front())) / int64_t(frames.back().Sequence - frames.front().Sequence), 1);
+
+		uint64_t sequence = Previous;
+		if (!secondField || !Previous) // The second field of an interlaced output shows the same frame
+		{
+			const int64_t target = outputNs - int64_t(delay) * outputPeriod;
+			auto picked = PickSyncFrame(std::span<FrameSyncRing::FrameInfo const>(frames), Previous, target, inputPeriod, Hysteresis, timeOf);
+			sequence = picked.value_or(Previous);
+			if (Previous && sequence == Previous)
+				++Repeats;
+			else if (Previous && sequence > Previous + 1)
+				Drops += uint32_t(sequence - Previous - 1);
+		}
+
+		size_t size = 0;
+		const uint8_t* data = Ring->BeginRead(sequence, size);
+		if (!data) // Overwritten since it was picked, the writer is far ahead
+		{
+			sequence = frames.back().Sequence;
+			data = Ring->BeginRead(sequence, size);
+		}
+		if (!data)
+			return NOS_RESULT_FAILED;
+		if (size != bufferToWrite.Info.Buffer.Size)
+		{
+			Ring->EndRead(sequence);
+			nosEngine.LogE("AJA Frame Sync: Frame size %zu doesn't match the buffer size %llu.", size, (unsigned long long)bufferToWrite.Info.Buffer.Size);
+			return NOS_RESULT_FAILED;
+		}
+		{
+			ScopedProfilerEvent _("AJA Frame Sync Read");
+			memcpy(nosVulkan->Map(&bufferToWrite), data, size);
+		}
+		Ring->EndRead(sequence);
+		auto picked = std::find_if(frames.begin(), frames.end(), [sequence](auto const& frame) { return frame.Sequence == sequence; });
+		if (picked != frames.end())
+			bufferToWrite.Info.Buffer.FieldType = nosTextureFieldType(picked->FieldType);
+		Previous = sequence;
+
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Output")].Id, Buffer::From(vkss::ConvertBufferInfo(bufferToWrite)));
+		if (Repeats != ReportedRepeats)
+		{
+			ReportedRepeats = Repeats;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Repeats")].Id, Buffer::From(Repeats));
+		}
+		if (Drops != ReportedDrops)
+		{
+			ReportedDrops = Drops;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Drops")].Id, Buffer::From(Drops));
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	// Period of the output's VBLs from consecutive executions, per field for interlaced outputs
+	int64_t UpdateOutputPeriod(int64_t vblNs, uint32_t vblCount)
+	{
+		if (LastVBLCount && vblCount > LastVBLCount && vblCount - LastVBLCount <= 4 && vblNs > LastVBLNs)
+		{
+			const int64_t period = (vblNs - LastVBLNs) / int64_t(vblCount - LastVBLCount);
+			// Smoothed, a single late wakeup shouldn't move the target
+			OutputPeriod = OutputPeriod ? (OutputPeriod * 15 + period) / 16 : period;
+		}
+		LastVBLNs = vblNs;
+		LastVBLCount = vblCount;
+		return OutputPeriod ? OutputPeriod : 20'000'000;
+	}
+
+	void OnPathStop() override
+	{
+		Previous = 0;
+		LastVBLCount = 0;
+		OutputPeriod = 0;
+	}
+
+	std::shared_ptr<FrameSyncRing> Ring;
+	std::string Name;
+	uint64_t Previous = 0;
+	int64_t LastVBLNs = 0;
+	uint32_t LastVBLCount = 0;
+	int64_t OutputPeriod = 0;
+	uint32_t Repeats = 0, ReportedRepeats = 0;
+	uint32_t Drops = 0, ReportedDrops = 0;
+};
+
+nosResult RegisterFrameSyncReadNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.FrameSyncRead"), FrameSyncReadNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
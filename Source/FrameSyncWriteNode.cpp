@@ -0,0 +1,102 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosVulkanSubsystem/Helpers.hpp>
+
+#include "AJA_generated.h"
+#include "AJAMain.h"
+#include "FrameSync.h"
+
+namespace nos::aja
+{
+
+// Input side of a frame synchronizer, copies each captured frame into the named ring. See FrameSync.h.
+struct FrameSyncWriteNodeContext : NodeContext
+{
+	FrameSyncWriteNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		nosResourceShareInfo input = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*execParams[NOS_NAME_STATIC("Input")].Data));
+		auto& metadataBuffer = *execParams[NOS_NAME_STATIC("Metadata")].Data;
+		std::string name = InterpretPinValue<const char>(*execParams[NOS_NAME_STATIC("Name")].Data);
+		uint32_t slotCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("Slots")].Data);
+
+		if (name.empty())
+		{
+			SetStatus("No ring name", fb::NodeStatusMessageType::WARNING);
+			return NOS_RESULT_FAILED;
+		}
+		if (!input.Memory.Handle)
+			return NOS_RESULT_FAILED;
+		auto fieldType = sys::vulkan::FieldType(input.Info.Buffer.FieldType);
+		if (fieldType == sys::vulkan::FieldType::EVEN || fieldType == sys::vulkan::FieldType::ODD)
+		{
+			// A field can't be repeated or skipped on its own without breaking the field order of the output
+			SetStatus("Fields can't be synchronized, set the Transfer Mode of DMA Read to PerFrame", fb::NodeStatusMessageType::FAILURE);
+			return NOS_RESULT_FAILED;
+		}
+		if (!Ring || name != Name)
+		{
+			Ring = FrameSyncRing::Get(name);
+			Name = name;
+		}
+		Ring->SetSlotCount(slotCount);
+
+		FrameSyncRing::FrameInfo info{};
+		if (metadataBuffer.Size)
+		{
+			auto* metadata = InterpretPinValue<FrameMetadata>(metadataBuffer);
+			if (metadata->dma_dropped())
+				return NOS_RESULT_SUCCESS; // Possibly torn, the reader repeats the previous frame instead
+			info.DeviceSerial = metadata->device_serial();
+			info.TimestampNs = metadata->timestamp_ns();
+			info.WakeupNs = metadata->wakeup_ns();
+			info.VBLCount = metadata->vbl_count();
+		}
+		if (!info.WakeupNs)
+			info.WakeupNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		info.FieldType = uint32_t(fieldType);
+
+		const size_t size = input.Info.Buffer.Size;
+		uint8_t* slot = Ring->BeginWrite(size);
+		if (!slot)
+		{
+			SetStatus("All slots are being read, add more slots", fb::NodeStatusMessageType::WARNING);
+			return NOS_RESULT_FAILED;
+		}
+		{
+			ScopedProfilerEvent _("AJA Frame Sync Write");
+			memcpy(slot, nosVulkan->Map(&input), size);
+		}
+		Ring->EndWrite(info);
+		SetStatus(Name, fb::NodeStatusMessageType::INFO);
+		return NOS_RESULT_SUCCESS;
+	}
+
+	void SetStatus(std::string const& text, fb::NodeStatusMessageType type)
+	{
+		if (text == Status)
+			return;
+		Status = text;
+		SetNodeStatusMessages({fb::TNodeStatusMessage{{}, text, type}});
+	}
+
+	std::shared_ptr<FrameSyncRing> Ring;
+	std::string Name;
+	std::string Status;
+};
+
+nosResult RegisterFrameSyncWriteNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.FrameSyncWrite"), FrameSyncWriteNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
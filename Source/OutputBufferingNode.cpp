@@ -0,0 +1,72 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+
+namespace nos::aja
+{
+
+// Drives the size of the buffer ring in front of an output. The output's DMA Write node reports how long after each
+// VBL its frame was ready and whether it dropped, see BufferingController.
+struct OutputBufferingNodeContext : NodeContext
+{
+	OutputBufferingNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
+		BufferingController::Settings settings{
+			.Adaptive = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Adaptive")].Data),
+			.MinDepth = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("MinDepth")].Data),
+			.MaxDepth = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("MaxDepth")].Data),
+			.ShrinkWaitFrames = *InterpretPinValue<float>(*execParams[NOS_NAME_STATIC("ShrinkWait")].Data),
+		};
+		const float stablePeriod = *InterpretPinValue<float>(*execParams[NOS_NAME_STATIC("StablePeriod")].Data);
+
+		uint32_t depth = std::max(settings.MaxDepth, 1u);
+		std::string reason = "No output channel";
+		if (channelInfo->device() && channelInfo->channel_name() && !channelInfo->is_input())
+		{
+			if (auto device = AJADevice::GetDeviceBySerialNumber(channelInfo->device()->serial_number()))
+			{
+				const nosVec2u deltaSeconds = GetDeltaSeconds(NTV2VideoFormat(channelInfo->video_format_idx()), false);
+				settings.StableFrames = uint32_t(std::max(stablePeriod, 0.f) * float(deltaSeconds.y) / float(deltaSeconds.x));
+				auto& controller = device->GetBufferingController(ParseChannel(channelInfo->channel_name()->string_view()));
+				controller.Configure(settings);
+				depth = controller.GetDepth();
+				reason = controller.GetReason();
+			}
+		}
+
+		if (depth != Depth)
+		{
+			Depth = depth;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Depth")].Id, Buffer::From(Depth));
+		}
+		if (reason != Reason)
+		{
+			Reason = std::move(reason);
+			if (settings.Adaptive)
+				nosEngine.LogI("AJA Output Buffering: %s", Reason.c_str());
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("Reason")].Id, nosBuffer{.Data = (void*)Reason.c_str(), .Size = Reason.size() + 1});
+		}
+		return NOS_RESULT_SUCCESS;
+	}
+
+	uint32_t Depth = 0;
+	std::string Reason;
+};
+
+nosResult RegisterOutputBufferingNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.OutputBuffering"), OutputBufferingNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
@@ -0,0 +1,314 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "RawClip.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nos::aja
+{
+AlignedBuffer::AlignedBuffer(size_t size) : Size(AlignRawClipSize(size))
+{
+#if defined(_WIN32)
+	Data = static_cast<uint8_t*>(_aligned_malloc(Size, RawClipAlignment));
+#else
+	void* data = nullptr;
+	if (posix_memalign(&data, RawClipAlignment, Size) == 0)
+		Data = static_cast<uint8_t*>(data);
+#endif
+	if (Data)
+		memset(Data, 0, Size);
+	else
+		Size = 0;
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+#if defined(_WIN32)
+	_aligned_free(Data);
+#else
+	free(Data);
+#endif
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) noexcept
+{
+	std::swap(Data, other.Data);
+	std::swap(Size, other.Size);
+	return *this;
+}
+
+RawClipWriter::RawClipWriter(std::string path, RawClipHeader header, uint32_t ringDepth) : Path(std::move(path)), Header(header)
+{
+	memcpy(Header.Magic, RawClipMagic, sizeof(RawClipMagic));
+	Header.Version = 1;
+	Header.HeaderSize = RawClipAlignment;
+	Header.FrameStride = AlignRawClipSize(Header.FrameSize);
+	Header.FrameCount = 0;
+
+#if defined(_WIN32)
+	File = CreateFileA(Path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+					   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, nullptr);
+#else
+#if defined(O_DIRECT)
+	File = open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	if (File == InvalidFile && errno == EINVAL) // File system without direct I/O support
+#endif
+		File = open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	if (!IsOpen())
+		return;
+	IndexFile = fopen(GetRawClipIndexPath(Path).c_str(), "wb");
+
+	Ring.resize(std::max(ringDepth, 2u));
+	for (auto& slot : Ring)
+		slot.Buffer = AlignedBuffer(Header.FrameStride);
+
+	WriteHeader();
+	Writer = std::thread([this] { WriterThread(); });
+}
+
+RawClipWriter::~RawClipWriter()
+{
+	if (!IsOpen())
+		return;
+	Stop = true;
+	Signal.fetch_add(1, std::memory_order_release);
+	Signal.notify_one();
+	if (Writer.joinable())
+		Writer.join();
+	Header.FrameCount = WrittenFrames;
+	WriteHeader();
+	if (IndexFile)
+		fclose(IndexFile);
+#if defined(_WIN32)
+	CloseHandle(File);
+#else
+	close(File);
+#endif
+}
+
+bool RawClipWriter::Push(const uint8_t* frame, size_t size, uint32_t vblCount, uint64_t timestampNs)
+{
+	if (!IsOpen() || size > Header.FrameSize)
+		return false;
+	auto head = Head.load(std::memory_order_relaxed);
+	if (head - Tail.load(std::memory_order_acquire) >= Ring.size())
+	{
+		++DroppedWrites;
+		return false;
+	}
+	auto& slot = Ring[head % Ring.size()];
+	memcpy(slot.Buffer.Data, frame, size);
+	slot.Entry = {.FrameNumber = head, .TimestampNs = timestampNs, .VBLCount = vblCount, .Flags = 0};
+	Head.store(head + 1, std::memory_order_release);
+	Signal.fetch_add(1, std::memory_order_release);
+	Signal.notify_one();
+	return true;
+}
+
+RawClipWriter::Stats RawClipWriter::GetStats()
+{
+	auto now = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::duration<double>(now - RateStart).count();
+	if (elapsed >= 1.0)
+	{
+		auto bytes = WrittenBytes.load();
+		Rate = double(bytes - RateBytes) / (1024.0 * 1024.0) / elapsed;
+		RateBytes = bytes;
+		RateStart = now;
+	}
+	return {.WrittenFrames = WrittenFrames, .DroppedWrites = DroppedWrites, .FailedWrites = FailedWrites, .MegabytesPerSecond = Rate};
+}
+
+void RawClipWriter::WriterThread()
+{
+	while (true)
+	{
+		auto signal = Signal.load(std::memory_order_acquire);
+		auto tail = Tail.load(std::memory_order_relaxed);
+		if (tail == Head.load(std::memory_order_acquire))
+		{
+			if (Stop)
+				break;
+			Signal.wait(signal);
+			continue;
+		}
+		auto& slot = Ring[tail % Ring.size()];
+		if (WriteAt(slot.Buffer.Data, Header.FrameStride, Header.HeaderSize + slot.Entry.FrameNumber * Header.FrameStride))
+		{
+			++WrittenFrames;
+			WrittenBytes += Header.FrameStride;
+			if (IndexFile)
+				fwrite(&slot.Entry, sizeof(slot.Entry), 1, IndexFile);
+		}
+		else
+			++FailedWrites;
+		Tail.store(tail + 1, std::memory_order_release);
+	}
+}
+
+bool RawClipWriter::WriteAt(const uint8_t* data, size_t size, uint64_t offset)
+{
+#if defined(_WIN32)
+	while (size)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD written = 0;
+		if (!WriteFile(File, data, DWORD(std::min<size_t>(size, 1u << 30)), &written, &overlapped) || !written)
+			return false;
+		data += written;
+		size -= written;
+		offset += written;
+	}
+#else
+	while (size)
+	{
+		auto written = pwrite(File, data, size, off_t(offset));
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= size_t(written);
+		offset += uint64_t(written);
+	}
+#endif
+	return true;
+}
+
+void RawClipWriter::WriteHeader()
+{
+	AlignedBuffer block(RawClipAlignment);
+	if (!block.Data)
+		return;
+	memcpy(block.Data, &Header, sizeof(Header));
+	WriteAt(block.Data, block.Size, 0);
+}
+
+RawClipReader::RawClipReader(std::string const& path)
+{
+	if (!Open(path))
+		Close();
+}
+
+bool RawClipReader::Open(std::string const& path)
+{
+#if defined(_WIN32)
+	File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		File = nullptr;
+		return false;
+	}
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(File, &size) || uint64_t(size.QuadPart) < RawClipAlignment)
+		return false;
+	MappingSize = uint64_t(size.QuadPart);
+	MappingHandle = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!MappingHandle)
+		return false;
+	Mapping = static_cast<uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	File = open(path.c_str(), O_RDONLY);
+	if (File < 0)
+		return false;
+	struct stat st{};
+	if (fstat(File, &st) != 0 || uint64_t(st.st_size) < RawClipAlignment)
+		return false;
+	MappingSize = uint64_t(st.st_size);
+	void* mapping = mmap(nullptr, MappingSize, PROT_READ, MAP_SHARED, File, 0);
+	if (mapping == MAP_FAILED)
+		return false;
+	Mapping = static_cast<uint8_t*>(mapping);
+	madvise(Mapping, MappingSize, MADV_SEQUENTIAL);
+#endif
+	if (!Mapping)
+		return false;
+
+	memcpy(&Header, Mapping, sizeof(Header));
+	if (memcmp(Header.Magic, RawClipMagic, sizeof(RawClipMagic)) != 0 || Header.HeaderSize > MappingSize || Header.HeaderSize % RawClipAlignment ||
+		!Header.FrameStride || Header.FrameStride % RawClipAlignment || Header.FrameSize > Header.FrameStride)
+		return false;
+	// Header is only finalized when the recorder is closed, fall back to what is on disk
+	FrameCount = (MappingSize - Header.HeaderSize) / Header.FrameStride;
+	if (Header.FrameCount)
+		FrameCount = std::min(FrameCount, Header.FrameCount);
+	return true;
+}
+
+RawClipReader::~RawClipReader()
+{
+	Close();
+}
+
+void RawClipReader::Close()
+{
+#if defined(_WIN32)
+	if (Mapping)
+		UnmapViewOfFile(Mapping);
+	if (MappingHandle)
+		CloseHandle(MappingHandle);
+	if (File)
+		CloseHandle(File);
+	MappingHandle = nullptr;
+	File = nullptr;
+#else
+	if (Mapping)
+		munmap(Mapping, MappingSize);
+	if (File >= 0)
+		close(File);
+	File = -1;
+#endif
+	Mapping = nullptr;
+	MappingSize = 0;
+	FrameCount = 0;
+}
+
+const uint8_t* RawClipReader::GetFrame(uint64_t frame) const
+{
+	if (!Mapping || frame >= FrameCount)
+		return nullptr;
+	return Mapping + Header.HeaderSize + frame * Header.FrameStride;
+}
+
+void RawClipReader::Prefetch(uint64_t first, uint64_t count, uint64_t wrapTo) const
+{
+	if (!Mapping || !FrameCount)
+		return;
+	while (count)
+	{
+		if (first >= FrameCount)
+			first = wrapTo < FrameCount ? wrapTo : 0;
+		// Prefetch contiguous runs with one call
+		uint64_t run = std::min(count, FrameCount - first);
+		auto* begin = const_cast<uint8_t*>(GetFrame(first));
+		size_t length = size_t(run * Header.FrameStride);
+#if defined(_WIN32)
+		WIN32_MEMORY_RANGE_ENTRY range{.VirtualAddress = begin, .NumberOfBytes = length};
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+		madvise(begin, length, MADV_WILLNEED);
+#endif
+		first += run;
+		count -= run;
+	}
+}
+} // namespace nos::aja
@@ -0,0 +1,166 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nos::aja
+{
+// Raw clip container
+// ------------------
+// A 4 KiB header, followed by frames in the layout DMA nodes use (2vuy or v210), each padded to a multiple of
+// 4 KiB so that they can be written unbuffered and mapped page aligned. Per-frame records go to "<clip>.idx".
+constexpr uint64_t RawClipAlignment = 4096;
+constexpr char RawClipMagic[8] = {'N', 'O', 'S', 'R', 'A', 'W', '0', '1'};
+
+inline uint64_t AlignRawClipSize(uint64_t size)
+{
+	return (size + RawClipAlignment - 1) & ~(RawClipAlignment - 1);
+}
+
+struct RawClipHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t HeaderSize;
+	uint32_t Width; // Raster size
+	uint32_t Height;
+	uint32_t PixelFormat; // nos::mediaio::YCbCrPixelFormat
+	uint32_t VideoFormat; // NTV2VideoFormat
+	uint32_t FieldTransfer; // Frames are single fields
+	uint32_t Reserved;
+	uint64_t FrameSize; // Bytes of each frame, without padding
+	uint64_t FrameStride; // Bytes between frames
+	uint64_t FrameCount; // Written when the clip is closed
+};
+static_assert(sizeof(RawClipHeader) <= RawClipAlignment);
+
+struct RawClipIndexEntry
+{
+	uint64_t FrameNumber;
+	uint64_t TimestampNs;
+	uint32_t VBLCount;
+	uint32_t Flags;
+};
+
+inline std::string GetRawClipIndexPath(std::string const& clipPath)
+{
+	return clipPath + ".idx";
+}
+
+// Allocations aligned for unbuffered I/O
+struct AlignedBuffer
+{
+	AlignedBuffer() = default;
+	explicit AlignedBuffer(size_t size);
+	~AlignedBuffer();
+	AlignedBuffer(AlignedBuffer&& other) noexcept : Data(other.Data), Size(other.Size) { other.Data = nullptr; other.Size = 0; }
+	AlignedBuffer& operator=(AlignedBuffer&& other) noexcept;
+	AlignedBuffer(AlignedBuffer const&) = delete;
+	AlignedBuffer& operator=(AlignedBuffer const&) = delete;
+
+	uint8_t* Data = nullptr;
+	size_t Size = 0;
+};
+
+// Streams frames to a raw clip from a preallocated ring of aligned buffers. Push never blocks: the caller copies
+// the frame into a free slot and a writer thread drains the ring with unbuffered writes. When the ring is full the
+// frame is dropped and counted.
+class RawClipWriter
+{
+public:
+	RawClipWriter(std::string path, RawClipHeader header, uint32_t ringDepth);
+	~RawClipWriter();
+
+	bool IsOpen() const { return File != InvalidFile; }
+	uint64_t GetFrameSize() const { return Header.FrameSize; }
+	bool Push(const uint8_t* frame, size_t size, uint32_t vblCount, uint64_t timestampNs);
+
+	struct Stats
+	{
+		uint64_t WrittenFrames;
+		uint64_t DroppedWrites; // Ring was full
+		uint64_t FailedWrites; // Storage errors
+		double MegabytesPerSecond; // Sustained rate over the last second
+	};
+	Stats GetStats();
+
+private:
+	void WriterThread();
+	bool WriteAt(const uint8_t* data, size_t size, uint64_t offset);
+	void WriteHeader();
+
+#if defined(_WIN32)
+	using FileHandle = void*;
+	static inline FileHandle const InvalidFile = (void*)(intptr_t)-1;
+#else
+	using FileHandle = int;
+	static constexpr FileHandle InvalidFile = -1;
+#endif
+	FileHandle File = InvalidFile;
+	FILE* IndexFile = nullptr;
+	std::string Path;
+	RawClipHeader Header;
+
+	struct Slot
+	{
+		AlignedBuffer Buffer;
+		RawClipIndexEntry Entry;
+	};
+	std::vector<Slot> Ring;
+	// Single producer, single consumer. Head is the next slot to fill, Tail the next slot to write.
+	std::atomic<uint64_t> Head = 0;
+	std::atomic<uint64_t> Tail = 0;
+	// Bumped whenever the writer thread has something to do
+	std::atomic<uint64_t> Signal = 0;
+	std::atomic_bool Stop = false;
+	std::thread Writer;
+
+	std::atomic<uint64_t> WrittenFrames = 0;
+	std::atomic<uint64_t> DroppedWrites = 0;
+	std::atomic<uint64_t> FailedWrites = 0;
+	std::atomic<uint64_t> WrittenBytes = 0;
+	uint64_t RateBytes = 0;
+	std::chrono::steady_clock::time_point RateStart = std::chrono::steady_clock::now();
+	double Rate = 0;
+};
+
+// Maps a raw clip read only. Frames are page aligned, so they can be handed to DMA as they are; the pages are read
+// from storage on first touch unless they are prefetched beforehand.
+class RawClipReader
+{
+public:
+	explicit RawClipReader(std::string const& path);
+	~RawClipReader();
+	RawClipReader(RawClipReader const&) = delete;
+	RawClipReader& operator=(RawClipReader const&) = delete;
+
+	bool IsOpen() const { return Mapping != nullptr; }
+	RawClipHeader const& GetHeader() const { return Header; }
+	uint64_t GetFrameCount() const { return FrameCount; }
+	const uint8_t* GetFrame(uint64_t frame) const;
+	// Asks the OS to start reading frames [first, first + count) in the background, wrapping around the clip end
+	void Prefetch(uint64_t first, uint64_t count, uint64_t wrapTo = 0) const;
+
+private:
+	bool Open(std::string const& path);
+	void Close();
+
+	RawClipHeader Header{};
+	uint64_t FrameCount = 0;
+	uint8_t* Mapping = nullptr;
+	uint64_t MappingSize = 0;
+#if defined(_WIN32)
+	void* File = nullptr;
+	void* MappingHandle = nullptr;
+#else
+	int File = -1;
+#endif
+};
+} // namespace nos::aja
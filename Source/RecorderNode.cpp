@@ -0,0 +1,157 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include <Nodos/PluginHelpers.hpp>
+
+// External
+#include <nosVulkanSubsystem/nosVulkanSubsystem.h>
+#include <nosVulkanSubsystem/Helpers.hpp>
+
+#include <future>
+
+#include "AJA_generated.h"
+#include "AJADevice.h"
+#include "AJAMain.h"
+#include "RawClip.h"
+
+namespace nos::aja
+{
+
+// Writes the frames coming out of DMA Read to a raw clip, without another readback.
+// The node only copies the frame into the recorder's ring; storage is written from a separate thread.
+// Opening the clip and allocating the ring also happen off the DMA thread, frames are skipped until that is done.
+struct RecorderNodeContext : NodeContext
+{
+	RecorderNodeContext(const nosFbNode* node) : NodeContext(node)
+	{
+	}
+
+	nosResult ExecuteNode(nosNodeExecuteParams* params) override
+	{
+		NodeExecuteParams execParams = params;
+		auto input = vkss::ConvertToResourceInfo(*InterpretPinValue<sys::vulkan::Buffer>(*execParams[NOS_NAME_STATIC("Input")].Data));
+		auto* channelInfo = InterpretPinValue<ChannelInfo>(*execParams[NOS_NAME_STATIC("Channel")].Data);
+		uint32_t curVBLCount = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("CurrentVBL")].Data);
+		auto& metadataBuffer = *execParams[NOS_NAME_STATIC("Metadata")].Data;
+		std::string path = InterpretPinValue<const char>(*execParams[NOS_NAME_STATIC("Path")].Data);
+		bool record = *InterpretPinValue<bool>(*execParams[NOS_NAME_STATIC("Record")].Data);
+		uint32_t ringDepth = *InterpretPinValue<uint32_t>(*execParams[NOS_NAME_STATIC("RingDepth")].Data);
+
+		if (!record)
+		{
+			StopRecording();
+			return NOS_RESULT_SUCCESS;
+		}
+		if (!input.Memory.Handle || !channelInfo->device())
+			return NOS_RESULT_FAILED;
+
+		if (!Writer && !Opening.valid())
+		{
+			if (path.empty())
+			{
+				SetStatus(fb::NodeStatusMessageType::FAILURE, "No clip path");
+				return NOS_RESULT_FAILED;
+			}
+			RawClipHeader header{};
+			if (auto* resolution = channelInfo->resolution())
+			{
+				header.Width = resolution->x();
+				header.Height = resolution->y();
+			}
+			header.PixelFormat = uint32_t(channelInfo->frame_buffer_format());
+			header.VideoFormat = uint32_t(channelInfo->video_format_idx());
+			header.FieldTransfer = input.Info.Buffer.FieldType != (nosTextureFieldType)sys::vulkan::FieldType::PROGRESSIVE;
+			header.FrameSize = input.Memory.Size;
+			OpeningPath = path;
+			Opening = std::async(std::launch::async, [path, header, ringDepth] { return std::make_unique<RawClipWriter>(path, header, ringDepth); });
+			SetStatus(fb::NodeStatusMessageType::INFO, "Opening " + path);
+			return NOS_RESULT_SUCCESS;
+		}
+		if (!Writer)
+		{
+			if (Opening.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return NOS_RESULT_SUCCESS;
+			Writer = Opening.get();
+			if (!Writer->IsOpen())
+			{
+				Writer.reset();
+				nosEngine.LogE("Recorder: Unable to open %s for writing.", OpeningPath.c_str());
+				SetStatus(fb::NodeStatusMessageType::FAILURE, "Unable to open " + OpeningPath);
+				return NOS_RESULT_FAILED;
+			}
+			FrameSize = Writer->GetFrameSize();
+			DroppedWrites = 0;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("DroppedWrites")].Id, Buffer::From(DroppedWrites));
+			Device = AJADevice::GetDeviceBySerialNumber(channelInfo->device()->serial_number());
+			SetStatus(fb::NodeStatusMessageType::INFO, "Recording to " + OpeningPath);
+		}
+		if (input.Memory.Size != FrameSize)
+		{
+			nosEngine.LogE("Recorder: Frame size changed while recording.");
+			return NOS_RESULT_FAILED;
+		}
+
+		{
+			ScopedProfilerEvent _("AJA Recorder Push");
+			u8* data = nosVulkan->Map(&input);
+			// Frames are stamped with the driver's time of their VBL, the one Wait VBL saw when it is in the metadata
+			uint64_t timestamp = 0;
+			if (metadataBuffer.Size)
+			{
+				auto* metadata = InterpretPinValue<FrameMetadata>(metadataBuffer);
+				curVBLCount = metadata->vbl_count();
+				timestamp = metadata->timestamp_ns();
+			}
+			if (AJADevice::InputFrameInfo info{}; !timestamp && Device && Device->ReadInputFrameInfo(ParseChannel(channelInfo->channel_name()->string_view()), info))
+				timestamp = info.TimestampNs;
+			Writer->Push(data, input.Memory.Size, curVBLCount, timestamp);
+		}
+
+		auto stats = Writer->GetStats();
+		uint32_t droppedWrites = uint32_t(stats.DroppedWrites + stats.FailedWrites);
+		if (droppedWrites != DroppedWrites)
+		{
+			DroppedWrites = droppedWrites;
+			nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("DroppedWrites")].Id, Buffer::From(DroppedWrites));
+		}
+		nosEngine.SetPinValue(execParams[NOS_NAME_STATIC("WriteRate")].Id, Buffer::From(float(stats.MegabytesPerSecond)));
+		return NOS_RESULT_SUCCESS;
+	}
+
+	void StopRecording()
+	{
+		if (Opening.valid())
+			Opening.get();
+		if (!Writer)
+			return;
+		auto stats = Writer->GetStats();
+		Writer.reset();
+		Device.reset();
+		nosEngine.LogI("Recorder: Wrote %llu frames, %llu dropped, %llu failed.", stats.WrittenFrames, stats.DroppedWrites, stats.FailedWrites);
+		SetStatus(fb::NodeStatusMessageType::INFO, "Stopped");
+	}
+
+	void SetStatus(fb::NodeStatusMessageType type, std::string text)
+	{
+		SetNodeStatusMessages({fb::TNodeStatusMessage{{}, std::move(text), type}});
+	}
+
+	void OnPathStop() override
+	{
+		StopRecording();
+	}
+
+	std::unique_ptr<RawClipWriter> Writer;
+	std::future<std::unique_ptr<RawClipWriter>> Opening;
+	std::string OpeningPath;
+	std::shared_ptr<AJADevice> Device; // For the VBL timestamps when no metadata is connected
+	size_t FrameSize = 0;
+	uint32_t DroppedWrites = 0;
+};
+
+nosResult RegisterRecorderNode(nosNodeFunctions* functions)
+{
+	NOS_BIND_NODE_CLASS(NOS_NAME_STATIC("nos.aja.Recorder"), RecorderNodeContext, functions)
+	return NOS_RESULT_SUCCESS;
+}
+
+}
@@ -0,0 +1,131 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "SharedFrameRing.h"
+
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace nos::aja
+{
+static constexpr uint64_t SharedFrameRingAlignment = 4096;
+
+static uint64_t AlignToPage(uint64_t size)
+{
+	return (size + SharedFrameRingAlignment - 1) & ~(SharedFrameRingAlignment - 1);
+}
+
+SharedFrameRing::SharedFrameRing(std::string name, Format const& format, uint32_t slotCount)
+	: Name(std::move(name)), CurrentFormat(format), SlotCount(slotCount)
+{
+	if (!SlotCount || !CurrentFormat.FrameSize)
+		return;
+	uint64_t headerSize = AlignToPage(sizeof(SharedFrameRingHeader) + SlotCount * sizeof(SharedFrameSlot));
+	uint64_t slotStride = AlignToPage(CurrentFormat.FrameSize);
+	MappingSize = headerSize + SlotCount * slotStride;
+
+	void* mapping = nullptr;
+#if defined(_WIN32)
+	Path = "Local\\nos.aja." + Name;
+	MappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(MappingSize >> 32),
+									   DWORD(MappingSize & 0xFFFFFFFF), Path.c_str());
+	if (!MappingHandle)
+		return;
+	mapping = MapViewOfFile(MappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!mapping)
+	{
+		CloseHandle(MappingHandle);
+		MappingHandle = nullptr;
+		return;
+	}
+#else
+	File = memfd_create(("nos.aja." + Name).c_str(), MFD_CLOEXEC);
+	if (File < 0)
+		return;
+	if (ftruncate(File, off_t(MappingSize)) != 0 ||
+		(mapping = mmap(nullptr, MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0)) == MAP_FAILED)
+	{
+		close(File);
+		File = -1;
+		return;
+	}
+	Path = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(File);
+#endif
+
+	memset(mapping, 0, headerSize);
+	Header = new (mapping) SharedFrameRingHeader{};
+	for (uint32_t i = 0; i < SlotCount; ++i)
+		new (&GetSlot(i)) SharedFrameSlot{};
+	Header->Version = 1;
+	Header->HeaderSize = uint32_t(headerSize);
+	Header->SlotCount = SlotCount;
+	Header->SlotStride = slotStride;
+	Header->FrameSize = CurrentFormat.FrameSize;
+	Header->Width = CurrentFormat.Width;
+	Header->Height = CurrentFormat.Height;
+	Header->PixelFormat = CurrentFormat.PixelFormat;
+	Header->VideoFormat = CurrentFormat.VideoFormat;
+	Header->FieldTransfer = CurrentFormat.FieldTransfer;
+	// Magic goes last, readers that find it can trust the rest of the header
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(Header->Magic, SharedFrameRingMagic, sizeof(SharedFrameRingMagic));
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+#if defined(_WIN32)
+	if (Header)
+		UnmapViewOfFile(Header);
+	if (MappingHandle)
+		CloseHandle(MappingHandle);
+#else
+	if (Header)
+		munmap(Header, MappingSize);
+	if (File >= 0)
+		close(File);
+#endif
+}
+
+SharedFrameSlot& SharedFrameRing::GetSlot(uint64_t frameNumber) const
+{
+	auto* slots = reinterpret_cast<SharedFrameSlot*>(Header + 1);
+	return slots[frameNumber % SlotCount];
+}
+
+uint8_t* SharedFrameRing::BeginWrite()
+{
+	if (!Header)
+		return nullptr;
+	Writing = Header->Published.load(std::memory_order_relaxed);
+	auto& slot = GetSlot(Writing);
+	slot.Sequence.store(2 * Writing + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return reinterpret_cast<uint8_t*>(Header) + Header->HeaderSize + (Writing % SlotCount) * Header->SlotStride;
+}
+
+void SharedFrameRing::EndWrite(bool captured, uint32_t vblCount, uint64_t timestampNs, uint32_t fieldType)
+{
+	if (!Header)
+		return;
+	auto& slot = GetSlot(Writing);
+	if (!captured)
+	{
+		// Leave the slot odd, readers skip it until it is written again
+		return;
+	}
+	slot.FrameNumber = Writing;
+	slot.TimestampNs = timestampNs;
+	slot.VBLCount = vblCount;
+	slot.FieldType = fieldType;
+	slot.Sequence.store(2 * Writing + 2, std::memory_order_release);
+	Header->Published.store(Writing + 1, std::memory_order_release);
+}
+} // namespace nos::aja
@@ -0,0 +1,98 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace nos::aja
+{
+// Shared frame ring
+// -----------------
+// Captured frames exported to other processes. The mapping starts with SharedFrameRingHeader, followed by SlotCount
+// SharedFrameSlot records, padded to a page. Frame data of slot i is at HeaderSize + i * SlotStride.
+//
+// Readers never block the writer. A slot's Sequence is odd while the slot is written and 2 * FrameNumber + 2 once
+// it is published; a reader that sees the same even Sequence before and after using the data got an intact frame.
+// Published is the number of frames published so far, the latest one is in slot (Published - 1) % SlotCount.
+constexpr char SharedFrameRingMagic[8] = {'N', 'O', 'S', 'R', 'I', 'N', 'G', '1'};
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+struct SharedFrameSlot
+{
+	std::atomic<uint64_t> Sequence;
+	uint64_t FrameNumber;
+	uint64_t TimestampNs; // VBL of the frame on the steady clock of the host, same across processes
+	uint32_t VBLCount;
+	uint32_t FieldType; // nos::sys::vulkan::FieldType
+};
+
+struct SharedFrameRingHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t HeaderSize;
+	uint32_t SlotCount;
+	uint32_t Reserved;
+	uint64_t SlotStride;
+	uint64_t FrameSize;
+	// Format of the frames, in the layout DMA nodes use
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t PixelFormat; // nos::mediaio::YCbCrPixelFormat
+	uint32_t VideoFormat; // NTV2VideoFormat
+	uint32_t FieldTransfer; // Frames are single fields
+	uint32_t Reserved2;
+	std::atomic<uint64_t> Published;
+};
+
+class SharedFrameRing
+{
+public:
+	struct Format
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t PixelFormat = 0;
+		uint32_t VideoFormat = 0;
+		bool FieldTransfer = false;
+		uint64_t FrameSize = 0;
+		bool operator==(Format const&) const = default;
+	};
+
+	SharedFrameRing(std::string name, Format const& format, uint32_t slotCount);
+	~SharedFrameRing();
+	SharedFrameRing(SharedFrameRing const&) = delete;
+	SharedFrameRing& operator=(SharedFrameRing const&) = delete;
+
+	bool IsOpen() const { return Header != nullptr; }
+	bool Matches(std::string const& name, Format const& format, uint32_t slotCount) const
+	{
+		return Name == name && CurrentFormat == format && SlotCount == slotCount;
+	}
+	// What readers open: "/proc/<pid>/fd/<fd>" of the memfd on Linux, the file mapping name on Windows
+	std::string const& GetPath() const { return Path; }
+
+	// Returns the data of the next slot, marked as being written. Only one writer is allowed.
+	uint8_t* BeginWrite();
+	// Publishes the slot returned by BeginWrite, or leaves it invalid if the capture failed
+	void EndWrite(bool captured, uint32_t vblCount, uint64_t timestampNs, uint32_t fieldType);
+
+private:
+	SharedFrameSlot& GetSlot(uint64_t frameNumber) const;
+
+	std::string Name;
+	std::string Path;
+	Format CurrentFormat;
+	uint32_t SlotCount = 0;
+	uint64_t MappingSize = 0;
+	SharedFrameRingHeader* Header = nullptr;
+	uint64_t Writing = 0;
+#if defined(_WIN32)
+	void* MappingHandle = nullptr;
+#else
+	int File = -1;
+#endif
+};
+} // namespace nos::aja
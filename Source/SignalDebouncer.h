@@ -0,0 +1,70 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+namespace nos::aja
+{
+// Settles the observed signal of an input. A new state is taken once it was seen in every poll for stableNs, so a
+// flapping cable makes one change when it settles instead of one per flap.
+class SignalDebouncer
+{
+public:
+	struct State
+	{
+		uint32_t Format = 0; // NTV2VideoFormat, unknown when there is no signal
+		uint32_t VPID = 0;
+		bool operator==(State const&) const = default;
+	};
+
+	// Feeds the state seen at nowNs. True when the settled state changed, see GetSettled and GetChangeStartNs.
+	bool Update(State observed, uint64_t nowNs, uint64_t stableNs)
+	{
+		if (!Initialized)
+		{
+			Initialized = true;
+			Settled = Candidate = observed;
+			return false;
+		}
+		if (observed == Settled)
+		{
+			// Went back before settling, not a change
+			Candidate = Settled;
+			Flaps = 0;
+			return false;
+		}
+		if (Candidate == Settled)
+			ChangeStartNs = nowNs;
+		if (observed != Candidate)
+		{
+			if (Candidate != Settled)
+				++Flaps;
+			Candidate = observed;
+			CandidateSinceNs = nowNs;
+			return false;
+		}
+		if (nowNs - CandidateSinceNs < stableNs)
+			return false;
+		Settled = Candidate;
+		LastFlaps = Flaps;
+		Flaps = 0;
+		return true;
+	}
+
+	State GetSettled() const { return Settled; }
+	// When the signal first left the previous settled state
+	uint64_t GetChangeStartNs() const { return ChangeStartNs; }
+	// States seen and abandoned before the last change settled
+	uint32_t GetFlaps() const { return LastFlaps; }
+
+private:
+	bool Initialized = false;
+	State Settled;
+	State Candidate;
+	uint64_t CandidateSinceNs = 0;
+	uint64_t ChangeStartNs = 0;
+	uint32_t Flaps = 0;
+	uint32_t LastFlaps = 0;
+};
+} // namespace nos::aja
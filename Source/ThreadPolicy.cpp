@@ -0,0 +1,226 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#include "ThreadPolicy.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <SetupAPI.h>
+#include <devpkey.h>
+#include <cwchar>
+#include <tuple>
+#else
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace nos::aja
+{
+std::vector<uint32_t> ParseCpuList(std::string_view list)
+{
+	std::vector<uint32_t> cpus;
+	while (!list.empty())
+	{
+		auto comma = list.find(',');
+		auto range = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+		while (!range.empty() && range.front() == ' ')
+			range.remove_prefix(1);
+		uint32_t first = 0, last = 0;
+		auto [end, ec] = std::from_chars(range.data(), range.data() + range.size(), first);
+		if (ec != std::errc())
+			continue;
+		last = first;
+		if (end != range.data() + range.size() && *end == '-')
+			std::from_chars(end + 1, range.data() + range.size(), last);
+		for (uint32_t cpu = first; cpu <= last && cpu < 4096; ++cpu)
+			cpus.push_back(cpu);
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return cpus;
+}
+
+std::vector<uint32_t> GetNumaNodeCpus(int numaNode)
+{
+	if (numaNode < 0)
+		return {};
+#if defined(_WIN32)
+	ULONGLONG mask = 0;
+	if (!GetNumaNodeProcessorMask(UCHAR(numaNode), &mask))
+		return {};
+	std::vector<uint32_t> cpus;
+	for (uint32_t cpu = 0; cpu < 64; ++cpu)
+		if (mask & (1ull << cpu))
+			cpus.push_back(cpu);
+	return cpus;
+#else
+	std::ifstream file("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist");
+	std::string list;
+	std::getline(file, list);
+	return ParseCpuList(list);
+#endif
+}
+
+#if defined(_WIN32)
+template <typename T>
+static bool GetDeviceProperty(HDEVINFO devices, SP_DEVINFO_DATA& info, DEVPROPKEY const& key, T& value)
+{
+	DEVPROPTYPE type = 0;
+	return SetupDiGetDevicePropertyW(devices, &info, &key, &type, reinterpret_cast<PBYTE>(&value), sizeof(value), nullptr, 0);
+}
+
+int FindPciNumaNode(uint16_t vendorId, size_t index)
+{
+	HDEVINFO devices = SetupDiGetClassDevsW(nullptr, L"PCI", nullptr, DIGCF_ALLCLASSES | DIGCF_PRESENT);
+	if (devices == INVALID_HANDLE_VALUE)
+		return -1;
+	wchar_t vendor[16] = {};
+	swprintf(vendor, 16, L"VEN_%04X", vendorId);
+	// Bus, device/function, NUMA node
+	std::vector<std::tuple<ULONG, ULONG, int>> functions;
+	SP_DEVINFO_DATA info{.cbSize = sizeof(SP_DEVINFO_DATA)};
+	for (DWORD i = 0; SetupDiEnumDeviceInfo(devices, i, &info); ++i)
+	{
+		wchar_t hardwareIds[512] = {};
+		DEVPROPTYPE type = 0;
+		if (!SetupDiGetDevicePropertyW(devices, &info, &DEVPKEY_Device_HardwareIds, &type, reinterpret_cast<PBYTE>(hardwareIds), sizeof(hardwareIds) - sizeof(wchar_t), nullptr, 0) ||
+			std::wstring_view(hardwareIds).find(vendor) == std::wstring_view::npos)
+			continue;
+		ULONG bus = 0, address = 0;
+		ULONG numaNode = ULONG(-1);
+		GetDeviceProperty(devices, info, DEVPKEY_Device_BusNumber, bus);
+		GetDeviceProperty(devices, info, DEVPKEY_Device_Address, address);
+		if (!GetDeviceProperty(devices, info, DEVPKEY_Device_Numa_Node, numaNode))
+			numaNode = ULONG(-1);
+		functions.emplace_back(bus, address, int(numaNode));
+	}
+	SetupDiDestroyDeviceInfoList(devices);
+	std::sort(functions.begin(), functions.end());
+	return index < functions.size() ? std::get<2>(functions[index]) : -1;
+}
+#else
+static std::string ReadSysfs(std::filesystem::path const& path)
+{
+	std::ifstream file(path);
+	std::string value;
+	std::getline(file, value);
+	return value;
+}
+
+int FindPciNumaNode(uint16_t vendorId, size_t index)
+{
+	char vendor[8] = {};
+	snprintf(vendor, sizeof(vendor), "0x%04x", vendorId);
+	std::error_code ec;
+	std::vector<std::filesystem::path> functions;
+	for (auto& entry : std::filesystem::directory_iterator("/sys/bus/pci/devices", ec))
+		if (ReadSysfs(entry.path() / "vendor") == vendor)
+			functions.push_back(entry.path());
+	std::sort(functions.begin(), functions.end());
+	if (index >= functions.size())
+		return -1;
+	try
+	{
+		return std::stoi(ReadSysfs(functions[index] / "numa_node"));
+	}
+	catch (...)
+	{
+		return -1;
+	}
+}
+#endif
+
+static std::vector<uint32_t> GetAllowedCpus(ThreadPolicy const& policy, int numaNode)
+{
+	std::vector<uint32_t> cpus;
+	if (policy.PinToCardNode)
+		cpus = GetNumaNodeCpus(numaNode);
+	if (cpus.empty())
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info{};
+		GetSystemInfo(&info);
+		const uint32_t count = info.dwNumberOfProcessors;
+#else
+		const uint32_t count = uint32_t(sysconf(_SC_NPROCESSORS_CONF));
+#endif
+		for (uint32_t cpu = 0; cpu < count; ++cpu)
+			cpus.push_back(cpu);
+	}
+	std::erase_if(cpus, [&](uint32_t cpu) { return std::find(policy.ExcludedCpus.begin(), policy.ExcludedCpus.end(), cpu) != policy.ExcludedCpus.end(); });
+	return cpus;
+}
+
+std::string ApplyThreadPolicy(ThreadPolicy const& policy, int numaNode)
+{
+	std::string errors;
+	auto cpus = GetAllowedCpus(policy, numaNode);
+	if (cpus.empty())
+		errors += "All CPUs are excluded. ";
+#if defined(_WIN32)
+	if (!SetThreadPriority(GetCurrentThread(), policy.RealTime ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL))
+		errors += "Unable to set thread priority. ";
+	DWORD_PTR mask = 0;
+	for (auto cpu : cpus)
+		if (cpu < sizeof(mask) * 8)
+			mask |= DWORD_PTR(1) << cpu;
+	if (mask && !SetThreadAffinityMask(GetCurrentThread(), mask))
+		errors += "Unable to set thread affinity. ";
+#else
+	sched_param param{};
+	param.sched_priority = policy.RealTime ? int(std::clamp(policy.Priority, 1u, 99u)) : 0;
+	if (int err = pthread_setschedparam(pthread_self(), policy.RealTime ? SCHED_FIFO : SCHED_OTHER, &param))
+		errors += std::string("Unable to set scheduling policy (") + strerror(err) + (err == EPERM ? ", needs CAP_SYS_NICE or an rtprio limit). " : "). ");
+	if (!cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (auto cpu : cpus)
+			if (cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+			errors += std::string("Unable to set thread affinity (") + strerror(err) + "). ";
+	}
+#endif
+	if (!errors.empty())
+		errors.pop_back();
+	return errors;
+}
+
+void WakeupHistogram::Add(uint64_t jitterNs)
+{
+	const uint64_t us = jitterNs / 1000;
+	const size_t bucket = std::min<size_t>(std::bit_width(us), Buckets.size() - 1);
+	++Buckets[bucket];
+	++Count;
+	MaxNs = std::max(MaxNs, jitterNs);
+}
+
+std::string WakeupHistogram::Summary() const
+{
+	if (!Count)
+		return "No wakeups";
+	auto percentile = [this](double p) {
+		const uint64_t rank = uint64_t(p * double(Count - 1)) + 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < Buckets.size(); ++i)
+			if ((seen += Buckets[i]) >= rank)
+				return uint64_t(1) << i; // Upper bound of the bucket
+		return uint64_t(1) << (Buckets.size() - 1);
+	};
+	return "p50 <" + std::to_string(percentile(0.5)) + "us p99 <" + std::to_string(percentile(0.99)) + "us p99.9 <" +
+		   std::to_string(percentile(0.999)) + "us max " + std::to_string(MaxNs / 1000) + "us (" + std::to_string(Count) + " wakeups)";
+}
+} // namespace nos::aja
@@ -0,0 +1,55 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace nos::aja
+{
+// Scheduling of the threads that wait for VBLs and transfer frames of a card
+struct ThreadPolicy
+{
+	bool RealTime = false; // SCHED_FIFO on Linux, time critical priority on Windows
+	uint32_t Priority = 80; // SCHED_FIFO priority, 1-99
+	bool PinToCardNode = false; // Run only on the CPUs of the NUMA node the card is attached to
+	std::vector<uint32_t> ExcludedCpus; // Kept off these, e.g. cores busy with rendering or interrupts
+	bool operator==(ThreadPolicy const&) const = default;
+};
+
+// What a thread had applied last, so that the policy is applied only when it or the thread changes
+struct AppliedThreadPolicy
+{
+	uint32_t Generation = 0;
+	std::thread::id Thread;
+};
+
+// "0-3,8,10-11" as used by sysfs and taskset
+std::vector<uint32_t> ParseCpuList(std::string_view list);
+// Empty if unknown
+std::vector<uint32_t> GetNumaNodeCpus(int numaNode);
+// NUMA node of the index-th PCI function of the vendor, in bus order. -1 if unknown.
+int FindPciNumaNode(uint16_t vendorId, size_t index);
+// Applies the policy to the calling thread. Returns what failed, empty on success.
+std::string ApplyThreadPolicy(ThreadPolicy const& policy, int numaNode);
+
+// Wakeup jitter of a thread waiting for VBLs, in power of two microsecond buckets
+class WakeupHistogram
+{
+public:
+	void Reset() { *this = {}; }
+	void Add(uint64_t jitterNs);
+	// "p50 <16us p99 <128us max 310us (1200 wakeups)"
+	std::string Summary() const;
+	uint64_t GetCount() const { return Count; }
+
+private:
+	std::array<uint64_t, 24> Buckets{};
+	uint64_t Count = 0;
+	uint64_t MaxNs = 0;
+};
+} // namespace nos::aja
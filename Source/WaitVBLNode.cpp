@@ -17,8 +17,12 @@ struct WaitVBLNodeContext : NodeContext
 	{
 	}
 
-	bool WaitVBL(AJADevice* device, NTV2Channel channel, bool isInput, bool isInterlaced, sys::vulkan::FieldType waitField)
+	bool WaitVBL(AJADevice* device, NTV2Channel channel, bool isInput, bool isInterlaced, sys::vulkan::FieldType waitField, InterlacedTransferMode transferMode)
 	{
+		if (!isInterlaced && WaitMode == VBLWaitMode::Hybrid)
+			return device->WaitVBLHybrid(channel, isInput, HybridWait, SpinWindow, SpinBudget);
+		if (isInterlaced && transferMode == InterlacedTransferMode::PerFrame)
+			return device->WaitVBL(channel, isInput, NTV2_FIELD0); // Frame boundary: both fields of the previous frame are complete
 		if (isInterlaced)
 		{
 			if (waitField == sys::vulkan::FieldType::UNKNOWN || waitField == sys::vulkan::FieldType::PROGRESSIVE)
@@ -36,6 +40,17 @@ struct WaitVBLNodeContext : NodeContext
 		nosUUID const* outId = &params[NOS_NAME_STATIC("VBL")].Id;
 		nosUUID const* outVBLCountId = &params[NOS_NAME_STATIC("CurrentVBL")].Id;
 		nos::sys::vulkan::FieldType waitField = *InterpretPinValue<nos::sys::vulkan::FieldType>(params[NOS_NAME("WaitField")].Data->Data);
+		auto transferMode = *InterpretPinValue<InterlacedTransferMode>(params[NOS_NAME_STATIC("TransferMode")].Data->Data);
+		auto waitMode = *InterpretPinValue<VBLWaitMode>(params[NOS_NAME_STATIC("WaitMode")].Data->Data);
+		SpinWindow = std::chrono::microseconds(*InterpretPinValue<uint32_t>(params[NOS_NAME_STATIC("SpinWindow")].Data->Data));
+		SpinBudget = std::chrono::microseconds(*InterpretPinValue<uint32_t>(params[NOS_NAME_STATIC("SpinBudget")].Data->Data));
+		if (waitMode != WaitMode)
+		{
+			// Distributions of the two modes are not mixed
+			WaitMode = waitMode;
+			HybridWait = {};
+			WakeupJitter.Reset();
+		}
 		nosUUID outFieldPinId = params[NOS_NAME("FieldType")].Id;
 		if (!channelInfo->device())
 			return NOS_RESULT_FAILED;
@@ -46,42 +61,62 @@ struct WaitVBLNodeContext : NodeContext
 		if (!channelStr)
 			return NOS_RESULT_FAILED;
 		auto channel = ParseChannel(channelStr->string_view());
+		device->ApplyThreadPolicy(AppliedPolicy, channelStr->string_view());
 
 		auto videoFormat = static_cast<NTV2VideoFormat>(channelInfo->video_format_idx());
 		bool isInterlaced = !IsProgressivePicture(videoFormat);
+		bool isFieldWait = isInterlaced && transferMode == InterlacedTransferMode::PerField;
 		bool vblSuccess = false;
 		for (int i = 0; i < (VBLState.LastVBLCount == 0 ? 2 : 1); ++i) // Wait one more VBL after restart so that we don't start DMA in the middle of a frame.
 		{
 			ScopedProfilerEvent _(channelInfo->channel_name()->str() + " Wait VBL");
-			vblSuccess = WaitVBL(device.get(), channel, channelInfo->is_input(), isInterlaced, waitField);
+			vblSuccess = WaitVBL(device.get(), channel, channelInfo->is_input(), isInterlaced, waitField, transferMode);
 		}
-		nosEngine.SetPinValue(outFieldPinId, nos::Buffer::From(isInterlaced ? InterlacedWaitField : sys::vulkan::FieldType::PROGRESSIVE));
+		auto outField = isFieldWait ? InterlacedWaitField : sys::vulkan::FieldType::PROGRESSIVE;
+		nosEngine.SetPinValue(outFieldPinId, nos::Buffer::From(outField));
 		ULWord curVBLCount = 0;
 		if (channelInfo->is_input())
 			device->GetInputVerticalInterruptCount(curVBLCount, channel);
 		else
 			device->GetOutputVerticalInterruptCount(curVBLCount, channel);
+		auto wakeup = std::chrono::steady_clock::now();
 		if (!vblSuccess)
 		{
 			nosEngine.CallNodeFunction(NodeId, NSN_VBLFailed);
 			return NOS_RESULT_FAILED;
 		}
 
+		// Timestamp and timecode of inputs are read in one go, outputs have no timecode to read
+		AJADevice::InputFrameInfo inputInfo{};
+		if (channelInfo->is_input())
+			device->ReadInputFrameInfo(channel, inputInfo);
+		uint64_t nanoseconds = channelInfo->is_input() ? inputInfo.TimestampNs : device->GetLastOutputVerticalInterruptTimestamp(channel);
 		if (channelInfo->is_input() && !VBLState.LastVBLCount)
 		{
-			uint64_t nanoseconds = device->GetLastInputVerticalInterruptTimestamp(channel);
 			nosPathCommand firstVblAfterStart{ .Event = NOS_FIRST_VBL_AFTER_START, .VBLTimestampNs = nanoseconds };
 			nosEngine.SendPathCommand(*outId, firstVblAfterStart);
 		}
 		ChannelStr = channelInfo->channel_name()->c_str();
 		IsInput = channelInfo->is_input();
 
+		TFrameMetadata metadata{};
+		metadata.device_serial = channelInfo->device()->serial_number();
+		metadata.channel = channel;
+		metadata.is_input = channelInfo->is_input();
+		metadata.vbl_count = curVBLCount;
+		metadata.timestamp_ns = nanoseconds;
+		metadata.wakeup_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(wakeup.time_since_epoch()).count());
+		metadata.field_type = uint32_t(outField);
+		metadata.transfer_mode = transferMode;
+		metadata.has_timecode = channelInfo->is_input() && AJADevice::DecodeTimecode(inputInfo.Timecode, videoFormat, metadata.timecode, metadata.timecode_frames);
+
 		if (VBLState.LastVBLCount)
 		{
 			int64_t vblDiff = (int64_t)curVBLCount - (int64_t)(VBLState.LastVBLCount + 1 + isInterlaced);
 			if (vblDiff > 0)
 			{
 				assert(vblDiff <= UINT32_MAX);
+				metadata.dropped_vbls = static_cast<uint32_t>(vblDiff);
 				FrameDropped(static_cast<uint32_t>(vblDiff), true);
 			} 
 			else
@@ -97,10 +132,32 @@ struct WaitVBLNodeContext : NodeContext
 				}
 			}
 		}
+		// How much the time between wakeups differs from the time between the interrupts, both clocks count the same VBLs
+		if (VBLState.LastVBLCount && !metadata.dropped_vbls && VBLState.LastTimestampNs)
+		{
+			int64_t wakeupInterval = std::chrono::duration_cast<std::chrono::nanoseconds>(wakeup - VBLState.LastWakeup).count();
+			int64_t vblInterval = int64_t(nanoseconds - VBLState.LastTimestampNs);
+			WakeupJitter.Add(uint64_t(std::abs(wakeupInterval - vblInterval)));
+			if (WakeupJitter.GetCount() % 64 == 0)
+			{
+				bool hybrid = WaitMode == VBLWaitMode::Hybrid && !isInterlaced;
+				nosEngine.WatchLog((ChannelStr + " VBL Wakeup Jitter").c_str(), ((hybrid ? "Hybrid: " : "Interrupt: ") + WakeupJitter.Summary()).c_str());
+				if (hybrid)
+					nosEngine.WatchLog((ChannelStr + " VBL Poll").c_str(), (std::to_string(HybridWait.PolledNs / 1000) + "us" + (HybridWait.UsedInterrupt ? ", fell back to interrupt" : "")).c_str());
+			}
+		}
+		VBLState.LastWakeup = wakeup;
+		VBLState.LastTimestampNs = nanoseconds;
 		VBLState.LastVBLCount = curVBLCount;
 		
 		nosEngine.SetPinDirty(*outId); // This is unnecessary for now, but when we remove automatically setting outputs dirty on execute, this will be required.
 		nosEngine.SetPinValue(*outVBLCountId, nos::Buffer::From(curVBLCount));
+		nosEngine.SetPinValue(params[NOS_NAME_STATIC("Metadata")].Id, nos::Buffer::From(metadata));
+		if (metadata.timecode != LastTimecode)
+		{
+			LastTimecode = metadata.timecode;
+			nosEngine.SetPinValue(params[NOS_NAME_STATIC("Timecode")].Id, nosBuffer{.Data = (void*)LastTimecode.c_str(), .Size = LastTimecode.size() + 1});
+		}
 		return NOS_RESULT_SUCCESS;
 	}
 
@@ -115,11 +172,21 @@ struct WaitVBLNodeContext : NodeContext
 		ULWord LastVBLCount = 0;
 		bool Dropped = false;
 		int FramesSinceLastDrop = 0;
+		std::chrono::steady_clock::time_point LastWakeup;
+		uint64_t LastTimestampNs = 0;
 	} VBLState;
+	WakeupHistogram WakeupJitter;
+	AppliedThreadPolicy AppliedPolicy;
+	VBLWaitMode WaitMode = VBLWaitMode::Interrupt;
+	AJADevice::HybridWaitState HybridWait;
+	std::chrono::microseconds SpinWindow{};
+	std::chrono::microseconds SpinBudget{};
 
 	void OnPathStart() override
 	{
 		VBLState = {};
+		HybridWait = {};
+		WakeupJitter.Reset();
 	}
 
 	void FrameDropped(uint32_t dropCount, bool vblMissed)
@@ -147,6 +214,7 @@ struct WaitVBLNodeContext : NodeContext
 	}
 
 	std::string ChannelStr;
+	std::string LastTimecode;
 	bool IsInput = false;
 };
 
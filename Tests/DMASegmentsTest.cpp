@@ -0,0 +1,147 @@
+// Copyright MediaZ Teknoloji A.S. All Rights Reserved.
+
+// Checks the segment layouts of DMASegments.h bit-exact against a simulated card: the segments are applied byte by byte
+// in both directions and the result is compared to where each byte of the raster has to end up.
+
+#include "DMASegments.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace nos::aja;
+
+static int Failures = 0;
+
+// Only the first failures are printed, a wrong layout fails for most bytes
+#define CHECK(cond, ...)                         \
+	if (!(cond) && ++Failures <= 20)             \
+	{                                            \
+		std::printf("FAILED: " __VA_ARGS__);     \
+		std::printf("\n");                       \
+	}
+
+// What the card does with a segmented transfer
+static void Transfer(DMASegments const& segments, bool toHost, std::vector<uint8_t>& host, std::vector<uint8_t>& card)
+{
+	for (uint32_t segment = 0; segment < segments.SegmentCount; ++segment)
+	{
+		const uint64_t hostStart = segments.HostOffset + uint64_t(segment) * segments.HostPitch;
+		const uint64_t cardStart = segments.CardOffset + uint64_t(segment) * segments.CardPitch;
+		for (uint32_t i = 0; i < segments.SegmentSize; ++i)
+		{
+			if (toHost)
+				host.at(hostStart + i) = card.at(cardStart + i);
+			else
+				card.at(cardStart + i) = host.at(hostStart + i);
+		}
+	}
+}
+
+static uint8_t Pattern(uint32_t store, uint64_t offset)
+{
+	return uint8_t((offset * 2654435761u >> 7) ^ (offset >> 3) ^ (store * 97 + 1));
+}
+
+// pitch and lines are of the whole raster, fieldId is negative for frames
+static void CheckQuadrants(uint32_t pitch, uint32_t lines, int fieldId)
+{
+	const uint32_t quadrantPitch = pitch / 2;
+	const uint32_t quadrantLines = lines / 2;
+	// Frame stores hold both fields of their quadrant when fields are transferred
+	const uint32_t storeLines = fieldId >= 0 ? quadrantLines * 2 : quadrantLines;
+	const size_t storeSize = size_t(quadrantPitch) * storeLines;
+	// Card store line and field line of a raster line
+	auto storeLine = [&](uint32_t line) { return fieldId >= 0 ? line * 2 + uint32_t(fieldId) : line; };
+
+	// Card to host
+	std::vector<uint8_t> host(size_t(pitch) * lines, 0);
+	std::vector<std::vector<uint8_t>> stores(4, std::vector<uint8_t>(storeSize));
+	for (uint32_t link = 0; link < 4; ++link)
+		for (size_t i = 0; i < storeSize; ++i)
+			stores[link][i] = Pattern(link, i);
+	for (uint32_t link = 0; link < 4; ++link)
+		Transfer(GetQuadrantSegments(link, pitch, lines, fieldId), true, host, stores[link]);
+	for (uint32_t y = 0; y < lines; ++y)
+		for (uint32_t x = 0; x < pitch; ++x)
+		{
+			const uint32_t link = (y >= quadrantLines) * 2 + (x >= quadrantPitch);
+			const size_t cardOffset = size_t(storeLine(y % quadrantLines)) * quadrantPitch + x % quadrantPitch;
+			CHECK(host[size_t(y) * pitch + x] == stores[link][cardOffset], "Quadrant read %ux%u field %d at line %u byte %u", pitch, lines, fieldId, y, x);
+		}
+
+	// Host to card
+	for (size_t i = 0; i < host.size(); ++i)
+		host[i] = Pattern(4, i);
+	for (auto& store : stores)
+		std::fill(store.begin(), store.end(), 0);
+	for (uint32_t link = 0; link < 4; ++link)
+		Transfer(GetQuadrantSegments(link, pitch, lines, fieldId), false, host, stores[link]);
+	for (uint32_t link = 0; link < 4; ++link)
+		for (uint32_t line = 0; line < storeLines; ++line)
+			for (uint32_t x = 0; x < quadrantPitch; ++x)
+			{
+				const uint8_t value = stores[link][size_t(line) * quadrantPitch + x];
+				if (fieldId >= 0 && line % 2 != uint32_t(fieldId))
+				{
+					CHECK(value == 0, "Quadrant write %ux%u field %d touched the other field, link %u line %u", pitch, lines, fieldId, link, line);
+					continue;
+				}
+				const uint32_t y = (link / 2) * quadrantLines + (fieldId >= 0 ? line / 2 : line);
+				const uint32_t hostX = (link % 2) * quadrantPitch + x;
+				CHECK(value == host[size_t(y) * pitch + hostX], "Quadrant write %ux%u field %d at link %u line %u byte %u", pitch, lines, fieldId, link, line, x);
+			}
+}
+
+// lines is the lines of one field
+static void CheckField(uint32_t pitch, uint32_t lines, uint32_t field)
+{
+	const size_t storeSize = size_t(pitch) * lines * 2;
+
+	// Card to host
+	std::vector<uint8_t> host(size_t(pitch) * lines, 0);
+	std::vector<uint8_t> store(storeSize);
+	for (size_t i = 0; i < storeSize; ++i)
+		store[i] = Pattern(0, i);
+	Transfer(GetFieldSegments(pitch, lines, field), true, host, store);
+	for (uint32_t y = 0; y < lines; ++y)
+		for (uint32_t x = 0; x < pitch; ++x)
+			CHECK(host[size_t(y) * pitch + x] == store[size_t(y * 2 + field) * pitch + x], "Field read %ux%u field %u at line %u byte %u", pitch, lines, field, y, x);
+
+	// Host to card
+	for (size_t i = 0; i < host.size(); ++i)
+		host[i] = Pattern(1, i);
+	std::fill(store.begin(), store.end(), 0);
+	Transfer(GetFieldSegments(pitch, lines, field), false, host, store);
+	for (uint32_t line = 0; line < lines * 2; ++line)
+		for (uint32_t x = 0; x < pitch; ++x)
+		{
+			const uint8_t value = store[size_t(line) * pitch + x];
+			const uint8_t expected = line % 2 == field ? host[size_t(line / 2) * pitch + x] : 0;
+			CHECK(value == expected, "Field write %ux%u field %u at line %u byte %u", pitch, lines, field, line, x);
+		}
+}
+
+int main()
+{
+	// Pitches of 2vuy and v210 lines, scaled down rasters keep the check fast while covering odd quadrant sizes
+	const uint32_t pitches[] = {3840 * 2 / 16, 5120 / 16 * 4, 24, 16};
+	const uint32_t lineCounts[] = {2160 / 20, 1080 / 20, 6, 2};
+	for (uint32_t pitch : pitches)
+		for (uint32_t lines : lineCounts)
+		{
+			CheckQuadrants(pitch, lines, -1);
+			CheckQuadrants(pitch, lines, 0);
+			CheckQuadrants(pitch, lines, 1);
+			CheckField(pitch, lines, 0);
+			CheckField(pitch, lines, 1);
+		}
+	// Full size UHD 10-bit frame and field
+	CheckQuadrants(10240, 2160, -1);
+	CheckQuadrants(10240, 1080, 1);
+
+	if (Failures)
+		std::printf("%d checks failed\n", Failures);
+	else
+		std::printf("All segment layouts match\n");
+	return Failures ? 1 : 0;
+}